@@ -0,0 +1,267 @@
+// AGENTS: the headless players under one signature, registered by name for the tournament
+#ifndef AGENTS_H
+#define AGENTS_H
+
+#include <cstring>
+
+#include "astar.h"
+#include "budget.h"
+#include "field.h"
+#include "mcts.h"
+#include "safety.h"
+
+using namespace std;
+
+// Data type: What an agent may use besides the board, set up once per game
+struct agent_state
+{
+    const rules *r;
+    // Prices of the variant for the budget planner
+    const budget_table *plan;
+    // Random stream of the game's agent, apart from the game's own
+    uint64_t seed;
+    // Search time per move, or rollouts per move when iterations > 0
+    double ms;
+    long iterations;
+    // Keys the scripted agent plays over and over
+    const char *script;
+    // Steps to the food the bfs agent heads for and to each apple for the budget agent,
+    // repaired from tick to tick
+    distance_field food;
+    apple_fields apples;
+};
+
+// Data type: Registered agent, move returns an action (index in KEYS)
+struct agent
+{
+    const char *name;
+    int (*move)(const board &b, agent_state *s);
+};
+
+// Data type: Fixed route through every cell but the top left corner, next cell of every
+// cell. Row 0 runs right, columns 24 .. 2 zigzag over rows 1 .. 14 and columns 0 and 1
+// come back up ending (0, 1) (1, 1) (1, 0), so the corner is one step off (0, 1) and one
+// step onto (1, 0). Needs an odd number of rows and columns
+struct cycle_route
+{
+    int16_t next[CELLS];
+
+    cycle_route()
+    {
+        static_assert(BOARD_ROWS % 2 == 1 && BOARD_COLUMNS % 2 == 1, "the route needs odd sides");
+        int order[CELLS];
+        int n = 0;
+        for (int x = 1; x < BOARD_COLUMNS; x++)
+        {
+            order[n++] = x;
+        }
+        for (int x = BOARD_COLUMNS - 1; x >= 2; x--)
+        {
+            bool down = (BOARD_COLUMNS - 1 - x) % 2 == 0;
+            for (int i = 1; i < BOARD_ROWS; i++)
+            {
+                int y = down ? i : BOARD_ROWS - i;
+                order[n++] = y * BOARD_COLUMNS + x;
+            }
+        }
+        for (int y = BOARD_ROWS - 1; y >= 1; y--)
+        {
+            bool left = (BOARD_ROWS - 1 - y) % 2 == 0;
+            order[n++] = y * BOARD_COLUMNS + (left ? 1 : 0);
+            order[n++] = y * BOARD_COLUMNS + (left ? 0 : 1);
+        }
+        for (int i = 0; i < n; i++)
+        {
+            next[order[i]] = order[(i + 1) % n];
+        }
+        next[0] = 1;
+    }
+};
+
+// Constant: Route of the cycle agent
+const cycle_route ROUTE;
+
+// Constant: Keys of the scripted agent by default, a 6 by 4 loop that never reverses
+const char *const SCRIPT = "DDDDDDSSSSAAAAAAWWWW";
+
+// Direction from one cell to a neighbour
+inline int direction_to(int from, int to)
+{
+    for (int d = 0; d < 4; d++)
+    {
+        if (from + DY[d] * BOARD_COLUMNS + DX[d] == to && from % BOARD_COLUMNS + DX[d] >= 0 && from % BOARD_COLUMNS + DX[d] < BOARD_COLUMNS)
+        {
+            return d;
+        }
+    }
+    return -1;
+}
+
+// Step with the most room when no food is behind a safe step, counting every room in full,
+// rooms holds the first counts and the first roomiest step, -1 when every step crashes
+inline int roomiest_step(const board &b, const rules &r, int *rooms, int roomiest)
+{
+    if (roomiest < 0)
+    {
+        return b.direction;
+    }
+    rooms_ahead(b, r, CELLS, rooms);
+    for (int d = 0; d < r.directions; d++)
+    {
+        if (rooms[d] > rooms[roomiest])
+        {
+            roomiest = d;
+        }
+    }
+    return roomiest;
+}
+
+// Greedy reference bot
+inline int greedy_agent(const board &b, agent_state *s)
+{
+    return greedy_board(b, *s->r);
+}
+
+// Shortest free path to the nearest food (bananas when the fruit snake runs low), among
+// the steps that do not trap the snake, otherwise the roomiest step
+inline int bfs_agent(const board &b, agent_state *s)
+{
+    const rules &r = *s->r;
+    bitboard open = without(MASKS.grid, b.body | b.trap);
+    set_bit(&open, b.tail);
+    const bitboard &food = (r.bananas > 0 && b.moves < HUNGER) ? b.banana : b.apple;
+    int rooms[8];
+    rooms_ahead(b, r, b.length, rooms);
+    update_field(&s->food, food, open, r.directions);
+    const int16_t *steps = s->food.steps;
+
+    int best = -1;
+    int roomiest = -1;
+    for (int d = 0; d < r.directions; d++)
+    {
+        if (rooms[d] < 0)
+        {
+            continue;
+        }
+        if (roomiest < 0 || rooms[d] > rooms[roomiest])
+        {
+            roomiest = d;
+        }
+        int cell = b.head + DY[d] * BOARD_COLUMNS + DX[d];
+        if (steps[cell] >= 0 && !trapped(b, rooms, d) && (best < 0 || steps[cell] < steps[b.head + DY[best] * BOARD_COLUMNS + DX[best]]))
+        {
+            best = d;
+        }
+    }
+    if (best >= 0)
+    {
+        return best;
+    }
+    return roomiest_step(b, r, rooms, roomiest);
+}
+
+// A* to the food that is cheapest for what it gives back, with diagonal steps costing their
+// extra move, among the steps that do not trap the snake, otherwise the roomiest step
+inline int astar_agent(const board &b, agent_state *s)
+{
+    const rules &r = *s->r;
+    const bitboard &food = (r.bananas > 0 && b.moves < HUNGER) ? b.banana : b.apple;
+    int rooms[8];
+    rooms_ahead(b, r, b.length, rooms);
+    bool allowed[8] = {};
+    int roomiest = -1;
+    for (int d = 0; d < r.directions; d++)
+    {
+        allowed[d] = rooms[d] >= 0 && !trapped(b, rooms, d);
+        if (rooms[d] >= 0 && (roomiest < 0 || rooms[d] > rooms[roomiest]))
+        {
+            roomiest = d;
+        }
+    }
+    int best = plan_route(b, r, food, allowed);
+    if (best >= 0)
+    {
+        return best;
+    }
+    return roomiest_step(b, r, rooms, roomiest);
+}
+
+// Moves budget planner, greedy on rules it does not cover
+inline int budget_agent(const board &b, agent_state *s)
+{
+    return budget_board(b, *s->r, *s->plan, &s->apples);
+}
+
+// Follow the fixed route, stepping into the corner when the apple is there
+inline int cycle_agent(const board &b, agent_state *s)
+{
+    (void) s;
+    if (b.head == BOARD_COLUMNS && test_bit(b.apple, 0))
+    {
+        return direction_to(b.head, 0);
+    }
+    return direction_to(b.head, ROUTE.next[b.head]);
+}
+
+// Tree search on one thread
+inline int search_agent(const board &b, agent_state *s)
+{
+    long rollouts = 0;
+    return search_action(b, *s->r, s->ms, s->iterations, 1, next_random(&s->seed), &rollouts);
+}
+
+// Scripted baseline: the keys of the script in turn whatever the board holds, keeping the
+// heading on keys the rules do not take
+inline int scripted_agent(const board &b, agent_state *s)
+{
+    const char *key = strchr(KEYS, s->script[b.ticks % strlen(s->script)]);
+    int action = key != NULL ? key - KEYS : b.direction;
+    if (action == TELEPORT ? !s->r->portal : action >= s->r->directions)
+    {
+        return b.direction;
+    }
+    return action;
+}
+
+// Random baseline: a random direction that does not crash on the spot
+inline int random_agent(const board &b, agent_state *s)
+{
+    int open[8];
+    int count = 0;
+    for (int d = 0; d < s->r->directions; d++)
+    {
+        if (open_action(b, *s->r, d))
+        {
+            open[count++] = d;
+        }
+    }
+    return count > 0 ? open[random_below(&s->seed, count)] : b.direction;
+}
+
+// Constant: Every registered agent
+const agent AGENTS[] = {
+    {"greedy",   greedy_agent},
+    {"bfs",      bfs_agent},
+    {"astar",    astar_agent},
+    {"budget",   budget_agent},
+    {"cycle",    cycle_agent},
+    {"search",   search_agent},
+    {"scripted", scripted_agent},
+    {"random",   random_agent},
+};
+const int AGENT_COUNT = sizeof(AGENTS) / sizeof(AGENTS[0]);
+
+// Registered agent of a name, NULL if none
+inline const agent *find_agent(const char *name)
+{
+    for (int a = 0; a < AGENT_COUNT; a++)
+    {
+        if (strcmp(AGENTS[a].name, name) == 0)
+        {
+            return &AGENTS[a];
+        }
+    }
+    return NULL;
+}
+
+#endif
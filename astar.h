@@ -0,0 +1,151 @@
+// COST-AWARE PLANNER: A* on bitboards to the food that costs the least to reach and is worth
+// the most, with the costs of the autopilot of the 8 direction programs
+#ifndef ASTAR_H
+#define ASTAR_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "field.h"
+
+using namespace std;
+
+// Constant: Planner costs, PLAN_MOVE_COST per move of the budget plus one per tick, so a
+// straight step costs 5 and a diagonal one costs 9 where it takes two moves
+const int PLAN_MOVE_COST = 4;
+
+// Constant: Planner node past the last cell that every goal leads into
+const int PLAN_SINK = CELLS;
+
+// Data type: Planner state of one search: path cost, first direction and closed flag of
+// every node, and what eating the food on each cell is worth
+struct route_plan
+{
+    int g[CELLS + 1];
+    int8_t first[CELLS + 1];
+    bool closed[CELLS + 1];
+    int value[CELLS];
+    int goals[CELLS];
+    int goal_count;
+    int best;
+    int straight;
+    int diagonal;
+};
+
+// Points and moves the food on a cell gives back, what the planner weighs moves against
+inline int food_value(const board &b, const rules &r, int cell)
+{
+    if (!r.economy)
+    {
+        return 1;
+    }
+    int age = max(item_age(b, cell), 0);
+    if (test_bit(b.banana, cell))
+    {
+        return recharge_banana(r.prices, age);
+    }
+    return reward(r.prices, age) + (r.bananas == 0 ? recharge(r.prices, age) : 0);
+}
+
+// Admissible estimate from cell c into the sink: the cheapest free grid path to a goal plus
+// its penalty, a diagonal step is no dearer than two straight ones so it takes min(dx, dy)
+inline int plan_estimate(const route_plan &p, int dirs, int c)
+{
+    if (c == PLAN_SINK)
+    {
+        return 0;
+    }
+    int best = INT32_MAX;
+    for (int i = 0; i < p.goal_count; i++)
+    {
+        int g = p.goals[i];
+        int dx = abs(c % BOARD_COLUMNS - g % BOARD_COLUMNS);
+        int dy = abs(c / BOARD_COLUMNS - g / BOARD_COLUMNS);
+        int h = dirs == 8 ? p.diagonal * min(dx, dy) + p.straight * (max(dx, dy) - min(dx, dy))
+                          : p.straight * (dx + dy);
+        best = min(best, h + PLAN_MOVE_COST * (p.best - p.value[g]));
+    }
+    return best;
+}
+
+// First direction of the cheapest path from the head into the goal sink, -1 when no goal is
+// in reach. The first step is one of allowed, later ones run through free cells. Eating a
+// goal costs PLAN_MOVE_COST for each point of value it falls short of the best goal, so the
+// path cost weighs moves spent against what the goal gives back
+inline int plan_route(const board &b, const rules &r, const bitboard &food, const bool *allowed)
+{
+    route_plan p;
+    p.straight = PLAN_MOVE_COST + 1;
+    p.diagonal = (r.diagonal_cost ? 2 : 1) * PLAN_MOVE_COST + 1;
+    p.goal_count = 0;
+    p.best = 0;
+    for (int c = next_bit(food, 0); c >= 0; c = next_bit(food, c + 1))
+    {
+        p.value[c] = food_value(b, r, c);
+        p.best = max(p.best, p.value[c]);
+        p.goals[p.goal_count++] = c;
+    }
+    if (p.goal_count == 0)
+    {
+        return -1;
+    }
+    bitboard open = without(MASKS.grid, b.body | b.trap);
+    set_bit(&open, b.tail);
+    for (int c = 0; c <= CELLS; c++)
+    {
+        p.g[c] = INT32_MAX;
+        p.closed[c] = false;
+    }
+
+    // Open nodes by estimated total cost, a node is pushed again when its cost drops and the
+    // older entry is skipped once the node is closed
+    priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> heap;
+    p.g[b.head] = 0;
+    heap.push({plan_estimate(p, r.directions, b.head), b.head});
+    while (!heap.empty())
+    {
+        int c = heap.top().second;
+        heap.pop();
+        if (p.closed[c])
+        {
+            continue;
+        }
+        if (c == PLAN_SINK)
+        {
+            return p.first[PLAN_SINK];
+        }
+        p.closed[c] = true;
+        if (c != b.head && test_bit(food, c))
+        {
+            int g = p.g[c] + PLAN_MOVE_COST * (p.best - p.value[c]);
+            if (g < p.g[PLAN_SINK])
+            {
+                p.g[PLAN_SINK] = g;
+                p.first[PLAN_SINK] = p.first[c];
+                heap.push({g, PLAN_SINK});
+            }
+        }
+        for (int d = 0; d < r.directions; d++)
+        {
+            int n = NEXT_CELLS.next[c][d];
+            if (n < 0 || p.closed[n] || !test_bit(open, n) || (c == b.head && !allowed[d]))
+            {
+                continue;
+            }
+            int g = p.g[c] + (d < 4 ? p.straight : p.diagonal);
+            if (g < p.g[n])
+            {
+                p.g[n] = g;
+                p.first[n] = c == b.head ? d : p.first[c];
+                heap.push({g + plan_estimate(p, r.directions, n), n});
+            }
+        }
+    }
+    return -1;
+}
+
+#endif
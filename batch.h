@@ -0,0 +1,419 @@
+// BATCHED GAMES: thousands of headless games stepped in lockstep
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "rules.h"
+
+using namespace std;
+
+// Item bits of a board cell
+const uint8_t BODY = 1;
+const uint8_t APPLE = 2;
+const uint8_t BANANA = 4;
+const uint8_t SNARE = 8;
+const uint8_t PORTAL = 16;
+// Items that age every tick
+const uint8_t AGING = APPLE | BANANA | SNARE;
+
+// Spawn attempts at random cells before scanning for a free one
+const int SPAWN_TRIES = 32;
+
+// Data type: Games stored as structure of arrays, every per-game field is its own
+// array indexed by game and every board plane is indexed by game * cells + cell
+struct batch
+{
+    rules r;
+    int games;
+    int cells;
+    // Finished games restart on the next step
+    bool auto_reset;
+
+    // Per game state
+    vector<int32_t> head_x;
+    vector<int32_t> head_y;
+    vector<int32_t> direction;
+    vector<int32_t> length;
+    vector<int32_t> moves;
+    vector<int32_t> score;
+    vector<int32_t> ticks;
+    // Ring buffer position of the head in the body plane
+    vector<int32_t> front;
+    // Open portal and the ticks it stays open
+    vector<int32_t> portal_x;
+    vector<int32_t> portal_y;
+    vector<int32_t> portal_time;
+    // Game is over and waits for reset_game (auto_reset off)
+    vector<int32_t> over;
+    vector<uint64_t> seed;
+
+    // Per game step results: score gained, game ended and how
+    vector<int32_t> reward;
+    vector<uint8_t> done;
+    vector<uint8_t> death;
+    // Totals of the game that ended this step, kept across the reset
+    vector<int32_t> final_length;
+    vector<int32_t> final_score;
+    vector<int32_t> final_moves;
+    vector<int32_t> final_ticks;
+
+    // Board planes: items, age of the item and the snake cells as a ring buffer
+    vector<uint8_t> item;
+    vector<int16_t> age;
+    vector<int16_t> body;
+
+    // Scratch of a step
+    vector<int32_t> next_x;
+    vector<int32_t> next_y;
+    vector<int32_t> jump;
+    vector<uint8_t> ate_apple;
+    vector<uint8_t> ate_banana;
+};
+
+void reset_game(batch *b, int g);
+
+// Allocate games of a variant and start them, game g seeds its generator with seed + g
+inline void setup_batch(batch *b, const rules &r, int games, uint64_t seed, bool auto_reset)
+{
+    b->r = r;
+    b->games = games;
+    b->cells = r.rows * r.columns;
+    b->auto_reset = auto_reset;
+
+    vector<int32_t> *lanes[] = {&b->head_x, &b->head_y, &b->direction, &b->length, &b->moves, &b->score,
+                                &b->ticks, &b->front, &b->portal_x, &b->portal_y, &b->portal_time,
+                                &b->reward, &b->final_length, &b->final_score, &b->final_moves, &b->final_ticks,
+                                &b->next_x, &b->next_y, &b->over, &b->jump};
+    for (vector<int32_t> *lane : lanes)
+    {
+        lane->assign(games, 0);
+    }
+    vector<uint8_t> *flags[] = {&b->done, &b->death, &b->ate_apple, &b->ate_banana};
+    for (vector<uint8_t> *flag : flags)
+    {
+        flag->assign(games, 0);
+    }
+    b->seed.resize(games);
+    b->item.assign((size_t) games * b->cells, 0);
+    b->age.assign((size_t) games * b->cells, 0);
+    b->body.assign((size_t) games * b->cells, 0);
+
+    for (int g = 0; g < games; g++)
+    {
+        b->seed[g] = seed + g;
+        reset_game(b, g);
+    }
+    return;
+}
+
+// Put an item on a random free cell of game g, returns the cell or -1 on a full board
+inline int spawn(batch *b, int g, uint8_t what)
+{
+    uint8_t *item = &b->item[(size_t) g * b->cells];
+    int cell = -1;
+    for (int i = 0; i < SPAWN_TRIES && cell < 0; i++)
+    {
+        int c = random_below(&b->seed[g], b->cells);
+        if (item[c] == 0)
+        {
+            cell = c;
+        }
+    }
+    // Crowded board, take the first free cell after a random one
+    if (cell < 0)
+    {
+        int start = random_below(&b->seed[g], b->cells);
+        for (int i = 0; i < b->cells && cell < 0; i++)
+        {
+            int c = (start + i) % b->cells;
+            if (item[c] == 0)
+            {
+                cell = c;
+            }
+        }
+    }
+    if (cell >= 0)
+    {
+        item[cell] = what;
+        b->age[(size_t) g * b->cells + cell] = -1;
+    }
+    return cell;
+}
+
+// Start game g over: snake of one cell in the centre heading right
+inline void reset_game(batch *b, int g)
+{
+    size_t base = (size_t) g * b->cells;
+    memset(&b->item[base], 0, b->cells * sizeof(uint8_t));
+    memset(&b->age[base], 0, b->cells * sizeof(int16_t));
+
+    b->head_x[g] = b->r.columns / 2;
+    b->head_y[g] = b->r.rows / 2;
+    b->direction[g] = 2;
+    b->length[g] = 1;
+    b->moves[g] = b->r.moves;
+    b->score[g] = 0;
+    b->ticks[g] = 0;
+    b->portal_time[g] = 0;
+    b->over[g] = 0;
+
+    int cell = b->head_y[g] * b->r.columns + b->head_x[g];
+    b->front[g] = 0;
+    b->body[base] = cell;
+    b->item[base + cell] = BODY;
+
+    if (b->r.traps)
+    {
+        spawn(b, g, SNARE);
+    }
+    for (int i = 0; i < b->r.apples; i++)
+    {
+        spawn(b, g, APPLE);
+    }
+    for (int i = 0; i < b->r.bananas; i++)
+    {
+        spawn(b, g, BANANA);
+    }
+    return;
+}
+
+// Record the end of game g, the end of the step restarts it when the batch resets automatically
+inline void end_game(batch *b, int g, int cause)
+{
+    b->done[g] = 1;
+    b->death[g] = cause;
+    b->final_length[g] = b->length[g];
+    b->final_score[g] = b->score[g];
+    b->final_moves[g] = b->moves[g];
+    b->final_ticks[g] = b->ticks[g];
+    if (!b->auto_reset)
+    {
+        b->over[g] = 1;
+    }
+    return;
+}
+
+// Pick the direction and next head cell of every game, branch free over plain arrays
+// so it vectorizes, finished games keep their moves
+inline void steer(int n, int dirs, int cost, const int32_t *__restrict actions, const int32_t *__restrict over,
+                  const int32_t *__restrict hx, const int32_t *__restrict hy,
+                  const int32_t *__restrict px, const int32_t *__restrict py, const int32_t *__restrict open,
+                  int32_t *__restrict dir, int32_t *__restrict moves,
+                  int32_t *__restrict nx, int32_t *__restrict ny, int32_t *__restrict jump)
+{
+    // Local copies of the direction tables, gathers from them cannot alias the outputs
+    int opposite[8];
+    int dx[8];
+    int dy[8];
+    for (int d = 0; d < 8; d++)
+    {
+        opposite[d] = OPPOSITE[d];
+        dx[d] = DX[d];
+        dy[d] = DY[d];
+    }
+    for (int g = 0; g < n; g++)
+    {
+        int a = actions[g];
+        int d = dir[g];
+        // Keys of other variants and reversals keep the direction
+        int turn = a < dirs ? a : d;
+        d = turn == opposite[d] ? d : turn;
+        int teleport = (a == TELEPORT && open[g] > 0) ? 1 : 0;
+        dir[g] = d;
+        jump[g] = teleport;
+        int x = hx[g] + dx[d];
+        int y = hy[g] + dy[d];
+        nx[g] = x + teleport * (px[g] - x);
+        ny[g] = y + teleport * (py[g] - y);
+        // Diagonal steps cost an extra move
+        moves[g] -= (cost && d >= 4 && over[g] == 0) ? 1 : 0;
+    }
+    return;
+}
+
+// Step every game with its action (index in KEYS), fills reward, done and death
+inline void step_batch(batch *b, const int32_t *actions)
+{
+    const int n = b->games;
+    const int cells = b->cells;
+    const int columns = b->r.columns;
+    const int dirs = b->r.directions;
+    const int cost = b->r.diagonal_cost;
+
+    int32_t *hx = b->head_x.data();
+    int32_t *hy = b->head_y.data();
+    int32_t *moves = b->moves.data();
+    int32_t *nx = b->next_x.data();
+    int32_t *ny = b->next_y.data();
+    int32_t *px = b->portal_x.data();
+    int32_t *py = b->portal_y.data();
+    int32_t *open = b->portal_time.data();
+    int32_t *jump = b->jump.data();
+
+    steer(n, dirs, cost, actions, b->over.data(), hx, hy, px, py, open, b->direction.data(), moves, nx, ny, jump);
+
+    // Move: collisions, eating and growth touch one board each
+    for (int g = 0; g < n; g++)
+    {
+        b->reward[g] = 0;
+        b->done[g] = 0;
+        b->death[g] = NONE;
+        b->ate_apple[g] = 0;
+        b->ate_banana[g] = 0;
+        if (b->over[g])
+        {
+            continue;
+        }
+        size_t base = (size_t) g * cells;
+        uint8_t *item = &b->item[base];
+        int16_t *body = &b->body[base];
+        b->ticks[g]++;
+
+        // Vacate the tail first, the head may follow it into its cell
+        int back = (b->front[g] - b->length[g] + 1 + cells) % cells;
+        int tail = body[back];
+        item[tail] &= ~BODY;
+        if (jump[g])
+        {
+            item[py[g] * columns + px[g]] &= ~PORTAL;
+            open[g] = 0;
+        }
+
+        int x = nx[g];
+        int y = ny[g];
+        if (x < 0 || x >= columns || y < 0 || y >= b->r.rows)
+        {
+            end_game(b, g, BOUNDARY);
+            continue;
+        }
+        int cell = y * columns + x;
+        if (item[cell] & BODY)
+        {
+            end_game(b, g, SELF);
+            continue;
+        }
+        if (item[cell] & SNARE)
+        {
+            end_game(b, g, TRAP);
+            continue;
+        }
+
+        hx[g] = x;
+        hy[g] = y;
+        b->front[g] = (b->front[g] + 1) % cells;
+        body[b->front[g]] = cell;
+        int age = b->age[base + cell];
+
+        if (item[cell] & APPLE)
+        {
+            int points = b->r.economy ? reward(b->r.prices, age) : 1;
+            if (b->r.economy && b->r.bananas == 0)
+            {
+                moves[g] += recharge(b->r.prices, age);
+            }
+            b->score[g] += points;
+            b->reward[g] = points;
+            b->ate_apple[g] = 1;
+            // Grow into the vacated tail cell
+            item[tail] |= BODY;
+            b->length[g]++;
+        }
+        else if (item[cell] & BANANA)
+        {
+            moves[g] += recharge_banana(b->r.prices, age);
+            b->ate_banana[g] = 1;
+        }
+        else if (item[cell] & PORTAL)
+        {
+            open[g] = 0;
+        }
+        else if (b->r.moves > 0)
+        {
+            moves[g]--;
+        }
+        item[cell] = BODY;
+        b->age[base + cell] = 0;
+    }
+
+    // Age: one pass over every board plane, vectorizes over games * cells
+    uint8_t *__restrict item = b->item.data();
+    int16_t *__restrict age = b->age.data();
+    const size_t planes = (size_t) n * cells;
+    for (size_t c = 0; c < planes; c++)
+    {
+        age[c] += (item[c] & AGING) != 0;
+    }
+    if (b->r.traps && b->r.trap_life > 0)
+    {
+        const int16_t life = b->r.trap_life;
+        for (size_t c = 0; c < planes; c++)
+        {
+            uint8_t expired = ((item[c] & SNARE) != 0) & (age[c] >= life);
+            item[c] &= ~(expired * SNARE);
+        }
+    }
+
+    // Spawn: portals, new items and running out of moves, then restart finished games
+    for (int g = 0; g < n; g++)
+    {
+        if (b->done[g] || b->over[g])
+        {
+            if (b->done[g] && b->auto_reset)
+            {
+                reset_game(b, g);
+            }
+            continue;
+        }
+        if (b->r.portal)
+        {
+            if (b->ticks[g] % b->r.teleport_reset == 0)
+            {
+                if (open[g] > 0)
+                {
+                    b->item[(size_t) g * cells + py[g] * columns + px[g]] &= ~PORTAL;
+                }
+                int cell = spawn(b, g, PORTAL);
+                if (cell >= 0)
+                {
+                    px[g] = cell % columns;
+                    py[g] = cell / columns;
+                    open[g] = b->r.teleport_time;
+                }
+            }
+            if (open[g] > 0)
+            {
+                open[g]--;
+            }
+            else
+            {
+                b->item[(size_t) g * cells + py[g] * columns + px[g]] &= ~PORTAL;
+            }
+        }
+        if (b->ate_apple[g])
+        {
+            if (b->r.traps)
+            {
+                spawn(b, g, SNARE);
+            }
+            spawn(b, g, APPLE);
+        }
+        if (b->ate_banana[g])
+        {
+            spawn(b, g, BANANA);
+        }
+        if (b->r.moves > 0 && moves[g] <= 0)
+        {
+            end_game(b, g, MOVES);
+            if (b->auto_reset)
+            {
+                reset_game(b, g);
+            }
+        }
+    }
+    return;
+}
+
+#endif
@@ -0,0 +1,727 @@
+// BITBOARD ENGINE: one headless game of the standard 25 x 15 grid on 64-bit words
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "rules.h"
+
+// Constant: Grid of the bitboard engine, cell = y * BOARD_COLUMNS + x
+const int BOARD_COLUMNS = 25;
+const int BOARD_ROWS = 15;
+const int CELLS = BOARD_ROWS * BOARD_COLUMNS;
+const int WORDS = (CELLS + 63) / 64;
+
+// Constant: Teleport jumps a snake body can hold, one per portal opening
+const int JUMPS = 32;
+
+// Constant: Link of a body cell whose next segment was reached by teleport
+const uint8_t JUMP = 8;
+
+// Constant: Items stop aging here, see board_fits
+const int AGE_CAP = 254;
+
+// Constant: Items that can reach AGE_CAP in one step, all spawned on the same tick
+const int PINS = 8;
+
+// Constant: Items that can spawn in one step: trap, apple, banana and portal
+const int SPAWNS = 4;
+
+// Constant: Spawn attempts at random cells before scanning for a free one, as in batch.h
+const int BOARD_SPAWN_TRIES = 32;
+
+// Data type: One bit per cell
+struct bitboard
+{
+    uint64_t word[WORDS];
+};
+
+// Bit operations
+
+inline bool test_bit(const bitboard &b, int cell)
+{
+    return (b.word[cell >> 6] >> (cell & 63)) & 1;
+}
+
+inline void set_bit(bitboard *b, int cell)
+{
+    b->word[cell >> 6] |= 1ULL << (cell & 63);
+    return;
+}
+
+inline void clear_bit(bitboard *b, int cell)
+{
+    b->word[cell >> 6] &= ~(1ULL << (cell & 63));
+    return;
+}
+
+inline bitboard operator|(const bitboard &a, const bitboard &b)
+{
+    bitboard c;
+    for (int w = 0; w < WORDS; w++)
+    {
+        c.word[w] = a.word[w] | b.word[w];
+    }
+    return c;
+}
+
+inline bitboard operator&(const bitboard &a, const bitboard &b)
+{
+    bitboard c;
+    for (int w = 0; w < WORDS; w++)
+    {
+        c.word[w] = a.word[w] & b.word[w];
+    }
+    return c;
+}
+
+// Cells of a that are not in b
+inline bitboard without(const bitboard &a, const bitboard &b)
+{
+    bitboard c;
+    for (int w = 0; w < WORDS; w++)
+    {
+        c.word[w] = a.word[w] & ~b.word[w];
+    }
+    return c;
+}
+
+inline bool same_bits(const bitboard &a, const bitboard &b)
+{
+    for (int w = 0; w < WORDS; w++)
+    {
+        if (a.word[w] != b.word[w])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool no_bits(const bitboard &b)
+{
+    uint64_t any = 0;
+    for (int w = 0; w < WORDS; w++)
+    {
+        any |= b.word[w];
+    }
+    return any == 0;
+}
+
+inline int count_bits(const bitboard &b)
+{
+    int n = 0;
+    for (int w = 0; w < WORDS; w++)
+    {
+        n += __builtin_popcountll(b.word[w]);
+    }
+    return n;
+}
+
+// Lowest set cell at or after cell, -1 if none
+inline int next_bit(const bitboard &b, int cell)
+{
+    if (cell >= CELLS)
+    {
+        return -1;
+    }
+    int w = cell >> 6;
+    uint64_t bits = b.word[w] & (~0ULL << (cell & 63));
+    while (bits == 0)
+    {
+        if (++w == WORDS)
+        {
+            return -1;
+        }
+        bits = b.word[w];
+    }
+    return (w << 6) + __builtin_ctzll(bits);
+}
+
+// Move every bit n cells up (n > 0) or down (n < 0), |n| < 64
+inline bitboard shift(const bitboard &b, int n)
+{
+    bitboard c;
+    if (n > 0)
+    {
+        for (int w = WORDS - 1; w > 0; w--)
+        {
+            c.word[w] = (b.word[w] << n) | (b.word[w - 1] >> (64 - n));
+        }
+        c.word[0] = b.word[0] << n;
+    }
+    else if (n < 0)
+    {
+        n = -n;
+        for (int w = 0; w < WORDS - 1; w++)
+        {
+            c.word[w] = (b.word[w] >> n) | (b.word[w + 1] << (64 - n));
+        }
+        c.word[WORDS - 1] = b.word[WORDS - 1] >> n;
+    }
+    else
+    {
+        c = b;
+    }
+    return c;
+}
+
+// Data type: Masks of the grid and of the cells a step left or right may leave from
+struct board_masks
+{
+    bitboard grid;
+    bitboard west;
+    bitboard east;
+
+    board_masks()
+    {
+        memset(this, 0, sizeof(*this));
+        for (int c = 0; c < CELLS; c++)
+        {
+            set_bit(&grid, c);
+            if (c % BOARD_COLUMNS != 0)
+            {
+                set_bit(&west, c);
+            }
+            if (c % BOARD_COLUMNS != BOARD_COLUMNS - 1)
+            {
+                set_bit(&east, c);
+            }
+        }
+    }
+};
+
+// Constant: Masks shared by the shift operations
+const board_masks MASKS;
+
+// Every cell of b moved one step in direction d, cells leaving the grid drop out
+inline bitboard step_bits(const bitboard &b, int d)
+{
+    bitboard from = b;
+    if (DX[d] < 0)
+    {
+        from = from & MASKS.west;
+    }
+    else if (DX[d] > 0)
+    {
+        from = from & MASKS.east;
+    }
+    return shift(from, DY[d] * BOARD_COLUMNS + DX[d]) & MASKS.grid;
+}
+
+// Cells one step from b in any of the first dirs directions
+inline bitboard neighbours(const bitboard &b, int dirs)
+{
+    bitboard n = step_bits(b, 0);
+    for (int d = 1; d < dirs; d++)
+    {
+        n = n | step_bits(b, d);
+    }
+    return n;
+}
+
+// Cells of open reachable from the cells of from, flooding a whole frontier per round
+inline bitboard reach(const bitboard &from, const bitboard &open, int dirs)
+{
+    bitboard seen = from & open;
+    while (true)
+    {
+        bitboard next = (neighbours(seen, dirs) & open) | seen;
+        if (same_bits(next, seen))
+        {
+            return seen;
+        }
+        seen = next;
+    }
+}
+
+// Data type: State of one game on bitboards, flat and trivially copyable so a clone
+// for lookahead is one memcpy of under a kilobyte
+struct board
+{
+    bitboard body;
+    bitboard apple;
+    bitboard banana;
+    bitboard trap;
+    bitboard portal;
+    // Items that reached AGE_CAP
+    bitboard old;
+    // Direction from each body cell to the next segment towards the head, a nibble per cell
+    uint8_t link[(CELLS + 1) / 2];
+    // Tick an item spawned on a cell, modulo 256, so items age without being written
+    uint8_t born[CELLS];
+    // Targets of the teleports still inside the body, oldest first
+    int16_t jumps[JUMPS];
+    int16_t jump_first;
+    int16_t jump_count;
+    int16_t head;
+    int16_t tail;
+    int16_t length;
+    int16_t direction;
+    int32_t moves;
+    int32_t score;
+    int32_t ticks;
+    int16_t portal_cell;
+    int16_t portal_time;
+    uint64_t seed;
+};
+
+static_assert(std::is_trivially_copyable<board>::value, "board must copy with memcpy");
+static_assert(sizeof(board) < 1024, "board must stay under a kilobyte");
+
+// Item planes of a board
+enum plane
+{
+    APPLE_PLANE,
+    BANANA_PLANE,
+    TRAP_PLANE,
+    PORTAL_PLANE
+};
+
+// Data type: What one step changed, enough for undo_board to put it back
+struct undo
+{
+    // Scalars before the step
+    int16_t head;
+    int16_t tail;
+    int16_t length;
+    int16_t direction;
+    int32_t moves;
+    int32_t score;
+    int32_t ticks;
+    int16_t jump_first;
+    int16_t jump_count;
+    int16_t portal_cell;
+    int16_t portal_time;
+    uint64_t seed;
+    // The portal was on the grid
+    bool portal_open;
+    // The head moved into its new cell, false when the step crashed
+    bool moved;
+    // Old link nibble of the old head and old entry of the jump slot written
+    uint8_t link;
+    int16_t jump;
+    // Item eaten by the head (plane or -1) and whether it was old
+    int8_t eaten;
+    bool eaten_old;
+    // Trap that expired, -1 if none
+    int16_t expired;
+    // Items that reached AGE_CAP
+    int8_t pin_count;
+    int16_t pins[PINS];
+    // Items spawned, their planes and the born ticks they replaced
+    int8_t spawn_count;
+    int16_t spawns[SPAWNS];
+    int8_t spawn_planes[SPAWNS];
+    uint8_t spawn_born[SPAWNS];
+};
+
+// Copy a game for lookahead
+inline void clone_board(board *to, const board &from)
+{
+    memcpy(to, &from, sizeof(board));
+    return;
+}
+
+// Item plane of a board
+inline bitboard *plane_of(board *b, int p)
+{
+    bitboard *planes[] = {&b->apple, &b->banana, &b->trap, &b->portal};
+    return planes[p];
+}
+
+// Link nibble of a cell
+inline int get_link(const board &b, int cell)
+{
+    return (b.link[cell >> 1] >> ((cell & 1) * 4)) & 15;
+}
+
+inline void set_link(board *b, int cell, int link)
+{
+    int bits = (cell & 1) * 4;
+    b->link[cell >> 1] = (b->link[cell >> 1] & ~(15 << bits)) | (link << bits);
+    return;
+}
+
+// Cell of the segment after cell towards the head
+inline int follow(const board &b, int cell)
+{
+    int link = get_link(b, cell);
+    if (link == JUMP)
+    {
+        return b.jumps[b.jump_first];
+    }
+    return cell + DY[link] * BOARD_COLUMNS + DX[link];
+}
+
+// Age of the item on a cell as the current step sees it before aging, spawns start at -1
+inline int item_age(const board &b, int cell)
+{
+    if (test_bit(b.old, cell))
+    {
+        return AGE_CAP;
+    }
+    return (uint8_t) (b.ticks - b.born[cell]) - 2;
+}
+
+// Ages at which the prices of the rules stop changing
+inline double flat_age(double start, double end, double slope)
+{
+    return slope > 0 ? (start - end) / slope : 0;
+}
+
+// Rules run on the bitboard engine: the grid is 25 x 15, no price or trap
+// depends on an age past AGE_CAP and the starting items fit an undo record
+inline bool board_fits(const rules &r)
+{
+    if (r.rows != BOARD_ROWS || r.columns != BOARD_COLUMNS || r.trap_life > AGE_CAP || r.apples + r.bananas + 1 > PINS)
+    {
+        return false;
+    }
+    const price_list &p = r.prices;
+    return !r.economy || (flat_age(p.reward_cap, 0, p.reward_rate) <= AGE_CAP &&
+                          flat_age(p.apple_base, p.apple_floor, p.apple_decay) <= AGE_CAP &&
+                          flat_age(p.banana_base, p.banana_floor, p.banana_decay) <= AGE_CAP);
+}
+
+// Occupied cells of a board
+inline bitboard taken(const board &b)
+{
+    return b.body | b.apple | b.banana | b.trap | b.portal;
+}
+
+// Put an item on a random free cell, returns the cell or -1 on a full board
+inline int spawn_bit(board *b, int p, undo *u)
+{
+    bitboard used = taken(*b);
+    int cell = -1;
+    for (int i = 0; i < BOARD_SPAWN_TRIES && cell < 0; i++)
+    {
+        int c = random_below(&b->seed, CELLS);
+        if (!test_bit(used, c))
+        {
+            cell = c;
+        }
+    }
+    // Crowded board, take the first free cell after a random one
+    if (cell < 0)
+    {
+        int start = random_below(&b->seed, CELLS);
+        bitboard open = without(MASKS.grid, used);
+        cell = next_bit(open, start);
+        if (cell < 0)
+        {
+            cell = next_bit(open, 0);
+        }
+    }
+    if (cell >= 0)
+    {
+        if (u != NULL)
+        {
+            u->spawns[u->spawn_count] = cell;
+            u->spawn_planes[u->spawn_count] = p;
+            u->spawn_born[u->spawn_count] = b->born[cell];
+            u->spawn_count++;
+        }
+        set_bit(plane_of(b, p), cell);
+        b->born[cell] = b->ticks;
+    }
+    return cell;
+}
+
+// Start a game of the rules r with its own random stream, false if the rules do not fit
+inline bool setup_board(board *b, const rules &r, uint64_t seed)
+{
+    if (!board_fits(r))
+    {
+        return false;
+    }
+    memset(b, 0, sizeof(*b));
+    b->seed = seed;
+    b->head = (BOARD_ROWS / 2) * BOARD_COLUMNS + BOARD_COLUMNS / 2;
+    b->tail = b->head;
+    b->length = 1;
+    b->direction = 2;
+    b->moves = r.moves;
+    set_bit(&b->body, b->head);
+
+    if (r.traps)
+    {
+        spawn_bit(b, TRAP_PLANE, NULL);
+    }
+    for (int i = 0; i < r.apples; i++)
+    {
+        spawn_bit(b, APPLE_PLANE, NULL);
+    }
+    for (int i = 0; i < r.bananas; i++)
+    {
+        spawn_bit(b, BANANA_PLANE, NULL);
+    }
+    return true;
+}
+
+// Step the game with an action (index in KEYS), returns how it ended or NONE,
+// same rules and random draws as step_batch. With u set the step can be undone.
+inline int step_board(board *b, const rules &r, int action, undo *u)
+{
+    if (u != NULL)
+    {
+        u->head = b->head;
+        u->tail = b->tail;
+        u->length = b->length;
+        u->direction = b->direction;
+        u->moves = b->moves;
+        u->score = b->score;
+        u->ticks = b->ticks;
+        u->jump_first = b->jump_first;
+        u->jump_count = b->jump_count;
+        u->portal_cell = b->portal_cell;
+        u->portal_time = b->portal_time;
+        u->seed = b->seed;
+        u->portal_open = test_bit(b->portal, b->portal_cell);
+        u->moved = false;
+        u->link = get_link(*b, b->head);
+        u->jump = b->jumps[(b->jump_first + b->jump_count) % JUMPS];
+        u->eaten = -1;
+        u->eaten_old = false;
+        u->expired = -1;
+        u->pin_count = 0;
+        u->spawn_count = 0;
+    }
+
+    int d = b->direction;
+    if (action < r.directions && action != OPPOSITE[d])
+    {
+        d = action;
+    }
+    b->direction = d;
+    bool jump = action == TELEPORT && b->portal_time > 0 && b->jump_count < JUMPS;
+    if (r.diagonal_cost && d >= 4)
+    {
+        b->moves--;
+    }
+    b->ticks++;
+
+    // Vacate the tail first, the head may follow it into its cell
+    int tail = b->tail;
+    clear_bit(&b->body, tail);
+
+    int cell;
+    if (jump)
+    {
+        cell = b->portal_cell;
+        clear_bit(&b->portal, cell);
+        b->portal_time = 0;
+    }
+    else
+    {
+        int x = b->head % BOARD_COLUMNS + DX[d];
+        int y = b->head / BOARD_COLUMNS + DY[d];
+        if (x < 0 || x >= BOARD_COLUMNS || y < 0 || y >= BOARD_ROWS)
+        {
+            return BOUNDARY;
+        }
+        cell = y * BOARD_COLUMNS + x;
+    }
+    if (test_bit(b->body, cell))
+    {
+        return SELF;
+    }
+    if (test_bit(b->trap, cell))
+    {
+        return TRAP;
+    }
+
+    // Link the old head to the new one
+    if (jump)
+    {
+        set_link(b, b->head, JUMP);
+        b->jumps[(b->jump_first + b->jump_count) % JUMPS] = cell;
+        b->jump_count++;
+    }
+    else
+    {
+        set_link(b, b->head, d);
+    }
+    b->head = cell;
+    set_bit(&b->body, cell);
+    if (u != NULL)
+    {
+        u->moved = true;
+    }
+
+    int eaten = -1;
+    if (test_bit(b->apple, cell))
+    {
+        if (r.economy)
+        {
+            b->score += reward(r.prices, item_age(*b, cell));
+            if (r.bananas == 0)
+            {
+                b->moves += recharge(r.prices, item_age(*b, cell));
+            }
+        }
+        else
+        {
+            b->score++;
+        }
+        eaten = APPLE_PLANE;
+        // Grow into the vacated tail cell
+        set_bit(&b->body, tail);
+        b->length++;
+    }
+    else if (test_bit(b->banana, cell))
+    {
+        b->moves += recharge_banana(r.prices, item_age(*b, cell));
+        eaten = BANANA_PLANE;
+    }
+    else if (test_bit(b->portal, cell))
+    {
+        eaten = PORTAL_PLANE;
+        b->portal_time = 0;
+    }
+    else if (r.moves > 0)
+    {
+        b->moves--;
+    }
+    if (eaten >= 0)
+    {
+        clear_bit(plane_of(b, eaten), cell);
+        if (u != NULL)
+        {
+            u->eaten = eaten;
+            u->eaten_old = test_bit(b->old, cell);
+        }
+        clear_bit(&b->old, cell);
+    }
+
+    // The tail moves on unless the snake grew
+    if (eaten != APPLE_PLANE)
+    {
+        b->tail = follow(*b, tail);
+        if (get_link(*b, tail) == JUMP)
+        {
+            b->jump_first = (b->jump_first + 1) % JUMPS;
+            b->jump_count--;
+        }
+    }
+
+    // Age the items: expire traps and pin the ones reaching AGE_CAP, old items are skipped
+    bitboard young = without(b->apple | b->banana | b->trap, b->old);
+    for (int c = next_bit(young, 0); c >= 0; c = next_bit(young, c + 1))
+    {
+        int age = item_age(*b, c) + 1;
+        if (r.trap_life > 0 && age >= r.trap_life && test_bit(b->trap, c))
+        {
+            clear_bit(&b->trap, c);
+            if (u != NULL)
+            {
+                u->expired = c;
+            }
+        }
+        else if (age >= AGE_CAP)
+        {
+            set_bit(&b->old, c);
+            if (u != NULL)
+            {
+                u->pins[u->pin_count++] = c;
+            }
+        }
+    }
+
+    if (r.portal)
+    {
+        if (b->ticks % r.teleport_reset == 0)
+        {
+            memset(&b->portal, 0, sizeof(b->portal));
+            int open = spawn_bit(b, PORTAL_PLANE, u);
+            if (open >= 0)
+            {
+                b->portal_cell = open;
+                b->portal_time = r.teleport_time;
+            }
+        }
+        if (b->portal_time > 0)
+        {
+            b->portal_time--;
+        }
+        else
+        {
+            memset(&b->portal, 0, sizeof(b->portal));
+        }
+    }
+    if (eaten == APPLE_PLANE)
+    {
+        if (r.traps)
+        {
+            spawn_bit(b, TRAP_PLANE, u);
+        }
+        spawn_bit(b, APPLE_PLANE, u);
+    }
+    if (eaten == BANANA_PLANE)
+    {
+        spawn_bit(b, BANANA_PLANE, u);
+    }
+    if (r.moves > 0 && b->moves <= 0)
+    {
+        return MOVES;
+    }
+    return NONE;
+}
+
+// Put back the state before the step u recorded, in reverse order of the step
+inline void undo_board(board *b, const undo &u)
+{
+    for (int i = u.spawn_count - 1; i >= 0; i--)
+    {
+        clear_bit(plane_of(b, u.spawn_planes[i]), u.spawns[i]);
+        b->born[u.spawns[i]] = u.spawn_born[i];
+    }
+    for (int i = 0; i < u.pin_count; i++)
+    {
+        clear_bit(&b->old, u.pins[i]);
+    }
+    if (u.expired >= 0)
+    {
+        set_bit(&b->trap, u.expired);
+    }
+    if (u.eaten >= 0)
+    {
+        set_bit(plane_of(b, u.eaten), b->head);
+        if (u.eaten_old)
+        {
+            set_bit(&b->old, b->head);
+        }
+    }
+    if (u.moved)
+    {
+        clear_bit(&b->body, b->head);
+    }
+    set_bit(&b->body, u.tail);
+
+    memset(&b->portal, 0, sizeof(b->portal));
+    if (u.portal_open)
+    {
+        set_bit(&b->portal, u.portal_cell);
+    }
+    set_link(b, u.head, u.link);
+    b->jumps[(u.jump_first + u.jump_count) % JUMPS] = u.jump;
+
+    b->head = u.head;
+    b->tail = u.tail;
+    b->length = u.length;
+    b->direction = u.direction;
+    b->moves = u.moves;
+    b->score = u.score;
+    b->ticks = u.ticks;
+    b->jump_first = u.jump_first;
+    b->jump_count = u.jump_count;
+    b->portal_cell = u.portal_cell;
+    b->portal_time = u.portal_time;
+    b->seed = u.seed;
+    return;
+}
+
+#endif
@@ -0,0 +1,169 @@
+// REFERENCE BOT: greedy headless player shared by the simulation tools
+#ifndef BOT_H
+#define BOT_H
+
+#include <cstdlib>
+
+#include "batch.h"
+#include "board.h"
+
+// Moves left under which the fruit bot heads for bananas
+const int HUNGER = 20;
+
+// Cell (x, y) of game g is on the grid and holds no snake or trap
+inline bool safe_cell(const batch &b, int g, int x, int y)
+{
+    if (x < 0 || x >= b.r.columns || y < 0 || y >= b.r.rows)
+    {
+        return false;
+    }
+    return (b.item[(size_t) g * b.cells + y * b.r.columns + x] & (BODY | SNARE)) == 0;
+}
+
+// Ticks between two cells
+inline int distance(const rules &r, int x1, int y1, int x2, int y2)
+{
+    int dx = abs(x1 - x2);
+    int dy = abs(y1 - y2);
+    if (r.directions == 8)
+    {
+        return dx > dy ? dx : dy;
+    }
+    return dx + dy;
+}
+
+// Action of game g: step towards the nearest apple (banana when the fruit snake runs low)
+// over safe cells, preferring cells with a way out, keep going when nothing is safe
+inline int greedy_action(const batch &b, int g)
+{
+    const rules &r = b.r;
+    const uint8_t *item = &b.item[(size_t) g * b.cells];
+    int hx = b.head_x[g];
+    int hy = b.head_y[g];
+
+    uint8_t food = APPLE;
+    if (r.bananas > 0 && b.moves[g] < HUNGER)
+    {
+        food = BANANA;
+    }
+    int tx = -1;
+    int ty = -1;
+    int nearest = b.cells;
+    for (int c = 0; c < b.cells; c++)
+    {
+        if (item[c] & food)
+        {
+            int d = distance(r, hx, hy, c % r.columns, c / r.columns);
+            if (d < nearest)
+            {
+                nearest = d;
+                tx = c % r.columns;
+                ty = c / r.columns;
+            }
+        }
+    }
+
+    int best = b.direction[g];
+    int best_cost = 1 << 30;
+    for (int d = 0; d < r.directions; d++)
+    {
+        if (d == OPPOSITE[b.direction[g]])
+        {
+            continue;
+        }
+        int x = hx + DX[d];
+        int y = hy + DY[d];
+        if (!safe_cell(b, g, x, y))
+        {
+            continue;
+        }
+        int exits = 0;
+        for (int e = 0; e < r.directions; e++)
+        {
+            exits += safe_cell(b, g, x + DX[e], y + DY[e]);
+        }
+        int cost = (tx < 0) ? 0 : distance(r, x, y, tx, ty) * 2;
+        cost += (r.diagonal_cost && d >= 4) ? 1 : 0;
+        cost += (exits == 0) ? 1000 : 0;
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            best = d;
+        }
+    }
+    return best;
+}
+
+// Actions of every game in the batch
+inline void greedy_actions(const batch &b, int32_t *actions)
+{
+    for (int g = 0; g < b.games; g++)
+    {
+        actions[g] = greedy_action(b, g);
+    }
+    return;
+}
+
+// Cell (x, y) is on the grid and not blocked, one bit test
+inline bool safe_bit(const bitboard &blocked, int x, int y)
+{
+    if (x < 0 || x >= BOARD_COLUMNS || y < 0 || y >= BOARD_ROWS)
+    {
+        return false;
+    }
+    return !test_bit(blocked, y * BOARD_COLUMNS + x);
+}
+
+// Action of a bitboard game, same choice as greedy_action but only food cells are visited
+inline int greedy_board(const board &b, const rules &r)
+{
+    int hx = b.head % BOARD_COLUMNS;
+    int hy = b.head / BOARD_COLUMNS;
+    const bitboard &food = (r.bananas > 0 && b.moves < HUNGER) ? b.banana : b.apple;
+    int tx = -1;
+    int ty = -1;
+    int nearest = CELLS;
+    for (int c = next_bit(food, 0); c >= 0; c = next_bit(food, c + 1))
+    {
+        int d = distance(r, hx, hy, c % BOARD_COLUMNS, c / BOARD_COLUMNS);
+        if (d < nearest)
+        {
+            nearest = d;
+            tx = c % BOARD_COLUMNS;
+            ty = c / BOARD_COLUMNS;
+        }
+    }
+
+    bitboard blocked = b.body | b.trap;
+    int best = b.direction;
+    int best_cost = 1 << 30;
+    for (int d = 0; d < r.directions; d++)
+    {
+        if (d == OPPOSITE[b.direction])
+        {
+            continue;
+        }
+        int x = hx + DX[d];
+        int y = hy + DY[d];
+        if (!safe_bit(blocked, x, y))
+        {
+            continue;
+        }
+        int exits = 0;
+        for (int e = 0; e < r.directions; e++)
+        {
+            exits += safe_bit(blocked, x + DX[e], y + DY[e]);
+        }
+        int cost = (tx < 0) ? 0 : distance(r, x, y, tx, ty) * 2;
+        cost += (r.diagonal_cost && d >= 4) ? 1 : 0;
+        cost += (exits == 0) ? 1000 : 0;
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            best = d;
+        }
+    }
+    return best;
+}
+
+#endif
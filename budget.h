@@ -0,0 +1,423 @@
+// BUDGET PLANNER: bitboard bot for the moves economy, dynamic programming over (position,
+// moves left). What moves left are worth after eating on a cell is solved once per variant,
+// every tick reads it through a distance field to each apple repaired from tick to tick
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "board.h"
+#include "bot.h"
+#include "field.h"
+#include "safety.h"
+
+using namespace std;
+
+// Constant: Weight of a point one tick later, the chance the game goes on for another tick.
+// Without it waiting for riper apples would always pay
+const double BUDGET_DISCOUNT = 0.9995;
+
+// Constant: Recharges on top of the starting moves the table covers, more moves left count
+// as that many
+const int BUDGET_RECHARGES = 10;
+
+// Constant: Sweeps of the moves table at most, and the change in value that ends them sooner
+const int BUDGET_SWEEPS = 2000;
+const double BUDGET_SETTLED = 1e-9;
+
+// Constant: Points for each wall or body cell beside a step, so that of two steps worth the
+// same the one keeping the body packed and the free cells in one piece is taken
+const double BUDGET_HUG = 2;
+
+// Data type: What moves are worth to a variant, built once and shared by every tick, game
+// and thread that plays it. A cell's position counts through its spread, the steps from
+// it to the next apple on average. The empty grid gives each cell its spread, a board with
+// a body and apples on it gives the apples' cells spreads of their own
+struct budget_table
+{
+    // The rules recharge moves with apples on a 4 direction bitboard
+    bool usable;
+    // Moves left the table covers, and apple ages it covers with older apples priced as
+    // the oldest since the prices stop changing there
+    int moves;
+    int ages;
+    // Spread of every cell of the empty grid, and one more than the largest spread covered
+    int8_t spread[CELLS];
+    int spreads;
+    // after[s][m]: points to come after eating on a cell of spread s with m moves left
+    vector<double> after;
+    // ahead[s][a][m]: points to come from an apple on a cell of spread s reached at age a
+    // with m moves to spare, eaten then or on a later tick that the moves last to
+    vector<double> ahead;
+};
+
+// Data type: Distance field to each apple, kept across ticks and repaired like the food
+// field of the bfs agent. A field keeps its apple until it is eaten, then takes a new one
+struct apple_fields
+{
+    distance_field to[PINS];
+};
+
+// Entry of the after table
+inline double &after_value(budget_table &t, int s, int m)
+{
+    return t.after[s * (t.moves + 1) + m];
+}
+
+inline double after_value(const budget_table &t, int s, int m)
+{
+    return t.after[s * (t.moves + 1) + min(m, t.moves)];
+}
+
+// Entry of the ahead table
+inline double ahead_value(const budget_table &t, int s, int age, int m)
+{
+    return t.ahead[((size_t) s * t.ages + min(age, t.ages - 1)) * (t.moves + 1) + min(m, t.moves)];
+}
+
+// Points to come from an apple on a cell of spread s that the head reaches at age with spare
+// moves left over, after is the value of moves left once it is eaten. Each tick of waiting
+// ripens the apple and costs a move, waiting on past the last age that changes its prices
+// only loses moves. Waiting takes steps off and back on, two ticks at a time
+inline double eat_value(const budget_table &t, const rules &r, const double *after, int age, int spare)
+{
+    double best = 0;
+    double weight = 1;
+    for (int wait = 0; wait <= spare; wait += 2)
+    {
+        int ripe = max(age + wait, 0);
+        int left = min(spare - wait + 1 + recharge(r.prices, ripe), t.moves);
+        best = max(best, weight * (reward(r.prices, ripe) + after[left]));
+        if (age + wait >= t.ages)
+        {
+            break;
+        }
+        weight *= BUDGET_DISCOUNT * BUDGET_DISCOUNT;
+    }
+    return best;
+}
+
+// Value of the moves of a variant. After eating, the next apple is a fresh one as far away
+// as the spread of the cell and lands the head on a cell picked like a spawn, so what moves
+// left are worth after eating on a cell solves for itself sweep by sweep
+inline budget_table make_budget(const rules &r)
+{
+    budget_table t;
+    t.usable = board_fits(r) && r.economy && r.moves > 0 && r.bananas == 0 && r.directions == 4 && !r.portal;
+    if (!t.usable)
+    {
+        return t;
+    }
+    const price_list &p = r.prices;
+    t.moves = r.moves + BUDGET_RECHARGES * (int) ceil(p.apple_base);
+    t.ages = (int) ceil(max(flat_age(p.reward_cap, 0, p.reward_rate), flat_age(p.apple_base, p.apple_floor, p.apple_decay))) + 1;
+
+    // Spread: the nearest of r.apples cells picked at random is at least k steps away as often
+    // as one of them is, to the power of the apples. Cells of one spread share the chances of
+    // each distance to the next apple
+    const int far = BOARD_ROWS + BOARD_COLUMNS;
+    vector<double> beyond(CELLS * far, 0);
+    t.spreads = 0;
+    for (int c = 0; c < CELLS; c++)
+    {
+        vector<int> at(far, 0);
+        for (int o = 0; o < CELLS; o++)
+        {
+            if (o != c)
+            {
+                at[abs(c % BOARD_COLUMNS - o % BOARD_COLUMNS) + abs(c / BOARD_COLUMNS - o / BOARD_COLUMNS)]++;
+            }
+        }
+        double mean = 0;
+        int left = CELLS - 1;
+        for (int k = 1; k < far; k++)
+        {
+            left -= at[k - 1];
+            beyond[c * far + k] = pow((double) left / (CELLS - 1), r.apples);
+            mean += beyond[c * far + k];
+        }
+        beyond[c * far] = 1;
+        t.spread[c] = max((int) lround(mean), 1);
+        t.spreads = max(t.spreads, t.spread[c] + 1);
+    }
+    // chance[s][k]: the next apple is k steps from a cell of spread s
+    vector<double> share(t.spreads, 0);
+    vector<double> chance(t.spreads * far, 0);
+    vector<int> members(t.spreads, 0);
+    for (int c = 0; c < CELLS; c++)
+    {
+        int s = t.spread[c];
+        share[s] += 1.0 / CELLS;
+        members[s]++;
+        for (int k = 1; k < far; k++)
+        {
+            chance[s * far + k] += beyond[c * far + k] - (k + 1 < far ? beyond[c * far + k + 1] : 0);
+        }
+    }
+    for (int s = 0; s < t.spreads; s++)
+    {
+        for (int k = 0; k < far && members[s] > 0; k++)
+        {
+            chance[s * far + k] /= members[s];
+        }
+    }
+    // The body walls cells in farther from the next apple than the empty grid, and another
+    // apple can lie nearer than the grid's apples would. A spread no cell of the grid has
+    // takes the chances of the nearest one that some cell has, moved by the difference
+    t.spreads = far;
+    share.resize(t.spreads, 0);
+    chance.resize(t.spreads * far, 0);
+    members.resize(t.spreads, 0);
+    for (int s = 1; s < t.spreads; s++)
+    {
+        int like = s;
+        for (int gap = 1; members[like] == 0; gap++)
+        {
+            like = s - gap >= 1 && members[s - gap] > 0 ? s - gap : s + gap < far && members[s + gap] > 0 ? s + gap : s;
+        }
+        for (int k = 1; k < far && like != s; k++)
+        {
+            chance[s * far + min(max(k + s - like, 1), far - 1)] += chance[like * far + k];
+        }
+    }
+
+    // Head start: an apple stays on the board for as many eats as there are apples, so the
+    // one eaten next has been waiting through the steps to the apples before it (Little's law)
+    double mean = 0;
+    for (int s = 0; s < t.spreads; s++)
+    {
+        for (int k = 1; k < far; k++)
+        {
+            mean += share[s] * chance[s * far + k] * k;
+        }
+    }
+    int head_start = (int) lround((r.apples - 1) * mean);
+
+    // Sweep until the values settle. landing[m] is what m moves left are worth after eating
+    // on a cell picked like a spawn, eaten[k][m] what they are worth with the next apple k
+    // steps away, eaten at age head_start + k
+    t.after.assign((size_t) t.spreads * (t.moves + 1), 0);
+    vector<double> landing(t.moves + 1, 0);
+    vector<double> eaten(far * (t.moves + 1), 0);
+    for (int sweep = 0; sweep < BUDGET_SWEEPS; sweep++)
+    {
+        for (int m = 0; m <= t.moves; m++)
+        {
+            landing[m] = 0;
+            for (int s = 0; s < t.spreads; s++)
+            {
+                landing[m] += share[s] * after_value(t, s, m);
+            }
+        }
+        for (int k = 1; k < far; k++)
+        {
+            for (int m = 0; m <= t.moves; m++)
+            {
+                eaten[k * (t.moves + 1) + m] = m < k ? 0 : pow(BUDGET_DISCOUNT, k) * eat_value(t, r, landing.data(), head_start + k, m - k);
+            }
+        }
+        double change = 0;
+        for (int s = 1; s < t.spreads; s++)
+        {
+            for (int m = 0; m <= t.moves; m++)
+            {
+                double value = 0;
+                for (int k = 1; k < far; k++)
+                {
+                    value += chance[s * far + k] * eaten[k * (t.moves + 1) + m];
+                }
+                change = max(change, fabs(value - after_value(t, s, m)));
+                after_value(t, s, m) = value;
+            }
+        }
+        if (change < BUDGET_SETTLED)
+        {
+            break;
+        }
+    }
+
+    // The apples on the board, eaten on a cell of their own spread
+    t.ahead.assign((size_t) t.spreads * t.ages * (t.moves + 1), 0);
+    for (int s = 1; s < t.spreads; s++)
+    {
+        for (int a = 0; a < t.ages; a++)
+        {
+            for (int m = 0; m <= t.moves; m++)
+            {
+                t.ahead[((size_t) s * t.ages + a) * (t.moves + 1) + m] = eat_value(t, r, &t.after[s * (t.moves + 1)], a, m);
+            }
+        }
+    }
+    return t;
+}
+
+// Point each field at an apple and repair it, the fields of apples still on the board keep
+// them and the others take the new apples
+inline void track_apples(const board &b, const rules &r, apple_fields *f)
+{
+    bitboard open = without(MASKS.grid, b.body | b.trap);
+    set_bit(&open, b.tail);
+    bitboard left = b.apple;
+    bool kept[PINS] = {};
+    for (int i = 0; i < r.apples; i++)
+    {
+        int cell = next_bit(f->to[i].targets, 0);
+        if (f->to[i].dirs != 0 && cell >= 0 && test_bit(left, cell))
+        {
+            kept[i] = true;
+            clear_bit(&left, cell);
+        }
+    }
+    for (int i = 0; i < r.apples; i++)
+    {
+        bitboard target = {};
+        if (kept[i])
+        {
+            target = f->to[i].targets;
+        }
+        else if (next_bit(left, 0) >= 0)
+        {
+            set_bit(&target, next_bit(left, 0));
+            clear_bit(&left, next_bit(left, 0));
+        }
+        update_field(&f->to[i], target, open, 4);
+    }
+    return;
+}
+
+// Spread of the cell of apple i on this board: the steps from it to the next apple averaged
+// over the free cells that apple can spawn on, an apple left on the board nearer than a spawn
+// or the only one in reach takes its place. The fields give the steps both ways
+inline int landing_spread(const board &b, const rules &r, const budget_table &t, const apple_fields &f, int i)
+{
+    int apple = next_bit(f.to[i].targets, 0);
+    int nearest = t.spreads - 1;
+    for (int j = 0; j < r.apples; j++)
+    {
+        if (j != i && next_bit(f.to[j].targets, 0) >= 0 && f.to[j].steps[apple] > 0)
+        {
+            nearest = min(nearest, (int) f.to[j].steps[apple]);
+        }
+    }
+    bitboard spawns = without(MASKS.grid, b.body | b.trap | b.apple);
+    const int16_t *steps = f.to[i].steps;
+    int total = 0;
+    for (int c = 0; c < CELLS; c++)
+    {
+        if (test_bit(spawns, c))
+        {
+            total += steps[c] >= 0 && steps[c] < nearest ? steps[c] : nearest;
+        }
+    }
+    int count = count_bits(spawns);
+    return count > 0 ? min(max((total + count / 2) / count, 1), t.spreads - 1) : t.spread[apple];
+}
+
+// Action of a bitboard game: every step that neither crashes nor traps the snake is valued
+// at the best apple it heads for, read off the table for the steps the apple's field gives
+// from the step's cell, its age by then, the moves to spare and the spread of its cell on
+// this board. With no apple behind a safe step the roomiest step is taken; rules the table
+// does not cover fall back to greedy_board
+inline int budget_board(const board &b, const rules &r, const budget_table &t, apple_fields *f)
+{
+    if (!t.usable)
+    {
+        return greedy_board(b, r);
+    }
+    int rooms[8];
+    rooms_ahead(b, r, b.length, rooms);
+    track_apples(b, r, f);
+    int landing[PINS];
+    for (int i = 0; i < r.apples; i++)
+    {
+        landing[i] = next_bit(f->to[i].targets, 0) >= 0 ? landing_spread(b, r, t, *f, i) : 0;
+    }
+
+    int best = -1;
+    double best_value = 0;
+    int roomiest = -1;
+    for (int d = 0; d < 4; d++)
+    {
+        if (rooms[d] < 0)
+        {
+            continue;
+        }
+        if (roomiest < 0 || rooms[d] > rooms[roomiest])
+        {
+            roomiest = d;
+        }
+        int cell = b.head + DY[d] * BOARD_COLUMNS + DX[d];
+        if (trapped(b, rooms, d))
+        {
+            continue;
+        }
+
+        double value = -1;
+        if (test_bit(b.apple, cell))
+        {
+            int age = max(item_age(b, cell) + 1, 0);
+            int spread = t.spread[cell];
+            for (int i = 0; i < r.apples; i++)
+            {
+                spread = next_bit(f->to[i].targets, 0) == cell ? landing[i] : spread;
+            }
+            value = reward(r.prices, age) + after_value(t, spread, b.moves + recharge(r.prices, age));
+        }
+        else
+        {
+            for (int i = 0; i < r.apples; i++)
+            {
+                int steps = f->to[i].steps[cell];
+                int apple = next_bit(f->to[i].targets, 0);
+                if (steps < 0 || apple < 0 || b.moves - 1 - steps < 0)
+                {
+                    continue;
+                }
+                int age = max(item_age(b, apple) + 1 + steps, 0);
+                value = max(value, pow(BUDGET_DISCOUNT, steps) * ahead_value(t, landing[i], age, b.moves - 1 - steps));
+            }
+        }
+        if (value < 0)
+        {
+            continue;
+        }
+
+        int packed = 0;
+        for (int e = 0; e < 4; e++)
+        {
+            int side = NEXT_CELLS.next[cell][e];
+            if (side < 0 || (side != b.head && test_bit(b.body, side)))
+            {
+                packed++;
+            }
+        }
+        value += BUDGET_HUG * packed;
+        if (best < 0 || value > best_value)
+        {
+            best_value = value;
+            best = d;
+        }
+    }
+    if (roomiest < 0)
+    {
+        return b.direction;
+    }
+    if (best >= 0)
+    {
+        return best;
+    }
+    // No apple behind a safe step, count every room in full
+    rooms_ahead(b, r, CELLS, rooms);
+    for (int d = 0; d < 4; d++)
+    {
+        if (rooms[d] > rooms[roomiest])
+        {
+            roomiest = d;
+        }
+    }
+    return roomiest;
+}
+
+#endif
@@ -0,0 +1,293 @@
+// REPLAY CORPUS TOOL: appends replays of the live games to a shard, lists its games and reads
+// its ticks in order or at random on every core
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "corpus.h"
+
+using namespace std;
+
+// Data type: What one reader thread read, the ticks and how often each input came up
+struct reading
+{
+    long ticks;
+    long arrows[8];
+    long kept;
+    long speed;
+    long jumps;
+};
+
+// Prototypes
+int append(const char *path, uint64_t capacity, char *files[], int count);
+void summary(const char *path, const corpus &c);
+void list_games(const corpus &c);
+void read_games(const corpus *c, atomic<uint64_t> *next, reading *r);
+void sample_ticks(const corpus *c, uint64_t seed, long samples, reading *r);
+void tally(reading *r, const corpus_tick &t);
+void report(const char *title, const vector<reading> &readings, double seconds);
+
+int main(int argc, char *argv[])
+{
+    // Options: -f SHARD to append to or read (replays.shard by default), -k CAPACITY games a new
+    // shard has room for, FILES after the options are appended to it. -l lists its games,
+    // -i reads every tick of every game, -r SAMPLES reads ticks drawn at random from -s SEED,
+    // both on -t THREADS readers
+    const char *path = "replays.shard";
+    uint64_t capacity = CORPUS_CAPACITY;
+    bool list = false;
+    bool iterate = false;
+    long samples = 0;
+    uint64_t seed = 1;
+    int threads = thread::hardware_concurrency();
+    int opt;
+    while ((opt = getopt(argc, argv, "f:k:lir:s:t:")) != -1)
+    {
+        if (opt == 'f')
+        {
+            path = optarg;
+        }
+        else if (opt == 'k')
+        {
+            capacity = strtoull(optarg, NULL, 10);
+        }
+        else if (opt == 'l')
+        {
+            list = true;
+        }
+        else if (opt == 'i')
+        {
+            iterate = true;
+        }
+        else if (opt == 'r')
+        {
+            samples = atol(optarg);
+        }
+        else if (opt == 's')
+        {
+            seed = strtoull(optarg, NULL, 10);
+        }
+        else if (opt == 't')
+        {
+            threads = atoi(optarg);
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-f SHARD] [-k CAPACITY] [-l] [-i] [-r SAMPLES] [-s SEED] [-t THREADS] [FILES]\n";
+            return 1;
+        }
+    }
+    threads = max(threads, 1);
+    if (optind < argc)
+    {
+        int failed = append(path, capacity, argv + optind, argc - optind);
+        if (failed < 0)
+        {
+            return 1;
+        }
+        if (failed > 0 || (!list && !iterate && samples == 0))
+        {
+            return failed > 0 ? 2 : 0;
+        }
+    }
+
+    corpus c;
+    if (!open_corpus(path, &c))
+    {
+        cerr << "Cannot read " << path << "\n";
+        return 1;
+    }
+    summary(path, c);
+    if (list)
+    {
+        list_games(c);
+    }
+    if (iterate)
+    {
+        vector<reading> readings(threads, reading());
+        atomic<uint64_t> next(0);
+        vector<thread> pool;
+        auto start = chrono::steady_clock::now();
+        for (int t = 0; t < threads; t++)
+        {
+            pool.emplace_back(read_games, &c, &next, &readings[t]);
+        }
+        for (thread &t : pool)
+        {
+            t.join();
+        }
+        report("ITERATE", readings, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    if (samples > 0)
+    {
+        vector<reading> readings(threads, reading());
+        vector<thread> pool;
+        auto start = chrono::steady_clock::now();
+        for (int t = 0; t < threads; t++)
+        {
+            long share = samples / threads + (t < samples % threads ? 1 : 0);
+            pool.emplace_back(sample_ticks, &c, seed + t, share, &readings[t]);
+        }
+        for (thread &t : pool)
+        {
+            t.join();
+        }
+        report("SAMPLE", readings, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    close_corpus(&c);
+    return 0;
+}
+
+// Append replay files to a shard under its writer lock, returns how many were not appended,
+// -1 if the shard cannot be opened
+int append(const char *path, uint64_t capacity, char *files[], int count)
+{
+    corpus_header h;
+    int fd = open_writer(path, capacity, &h);
+    if (fd < 0)
+    {
+        cerr << "Cannot write " << path << "\n";
+        return -1;
+    }
+    int failed = 0;
+    for (int i = 0; i < count; i++)
+    {
+        ifstream in(files[i], ios::binary);
+        string replay((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        if (!in || !append_replay(fd, &h, (const uint8_t *) replay.data(), replay.size()))
+        {
+            cerr << "Cannot append " << files[i] << (h.games >= h.capacity ? ", the shard is full" : "") << "\n";
+            failed++;
+        }
+    }
+    close_writer(fd);
+    cout << "APPENDED " << count - failed << " of " << count << " replays to " << path << " games " << h.games
+         << " of " << h.capacity << "\n";
+    return failed;
+}
+
+// Games, ticks and bytes of a shard, then the same by variant with the mean score
+void summary(const char *path, const corpus &c)
+{
+    cout << "CORPUS " << path << " games " << c.games << " ticks " << c.ticks << " bytes " << c.bytes << "\n";
+    cout << "VARIANT        games       ticks     score\n";
+    for (int v = 0; v < VARIANTS; v++)
+    {
+        long games = 0;
+        long ticks = 0;
+        double score = 0;
+        for (uint64_t g = 0; g < c.games; g++)
+        {
+            if (c.entries[g].variant == (uint32_t) v)
+            {
+                games++;
+                ticks += c.entries[g].ticks;
+                score += c.entries[g].score;
+            }
+        }
+        if (games > 0)
+        {
+            cout << left << setw(10) << RULES[v].name << right << setw(10) << games << setw(12) << ticks
+                 << setw(10) << fixed << setprecision(1) << score / games << "\n";
+        }
+    }
+    return;
+}
+
+// One line per game of the index
+void list_games(const corpus &c)
+{
+    cout << "GAME          offset    length  variant        seed     score     ticks      size\n";
+    for (uint64_t g = 0; g < c.games; g++)
+    {
+        const corpus_entry &e = c.entries[g];
+        cout << left << setw(8) << g << right << setw(12) << e.offset << setw(10) << e.length << "  "
+             << left << setw(7) << RULES[e.variant].name << right << setw(12) << e.seed << setw(10) << e.score
+             << setw(10) << e.ticks << setw(10) << e.size << "\n";
+    }
+    return;
+}
+
+// Reader thread: every tick of the next game until none are left
+void read_games(const corpus *c, atomic<uint64_t> *next, reading *r)
+{
+    uint64_t g;
+    while ((g = next->fetch_add(1)) < c->games)
+    {
+        replay_cursor cursor;
+        corpus_tick t;
+        if (c->entries[g].ticks == 0 || !seek_tick(*c, g, 0, &cursor))
+        {
+            continue;
+        }
+        while (next_tick(&cursor, &t))
+        {
+            tally(r, t);
+        }
+    }
+    return;
+}
+
+// Reader thread: ticks drawn at random from its own stream
+void sample_ticks(const corpus *c, uint64_t seed, long samples, reading *r)
+{
+    corpus_tick t;
+    for (long i = 0; i < samples; i++)
+    {
+        if (sample_tick(*c, &seed, &t))
+        {
+            tally(r, t);
+        }
+    }
+    return;
+}
+
+// Count a tick and its input
+void tally(reading *r, const corpus_tick &t)
+{
+    r->ticks++;
+    if (t.arrow >= 0)
+    {
+        r->arrows[t.arrow]++;
+    }
+    else
+    {
+        r->kept++;
+    }
+    r->speed += (t.events >> REPLAY_SPEED) & 1;
+    r->jumps += (t.events >> REPLAY_JUMP) & 1;
+    return;
+}
+
+// Throughput of the readers and how often each input came up
+void report(const char *title, const vector<reading> &readings, double seconds)
+{
+    reading total = {};
+    for (const reading &r : readings)
+    {
+        total.ticks += r.ticks;
+        for (int a = 0; a < 8; a++)
+        {
+            total.arrows[a] += r.arrows[a];
+        }
+        total.kept += r.kept;
+        total.speed += r.speed;
+        total.jumps += r.jumps;
+    }
+    cout << title << " readers " << readings.size() << " ticks " << total.ticks << " seconds " << fixed
+         << setprecision(3) << seconds << " ticks/s " << setprecision(0) << total.ticks / max(seconds, 1e-9) << "\n";
+    cout << "INPUT";
+    for (int a = 0; a < 8; a++)
+    {
+        cout << " " << KEYS[a] << " " << total.arrows[a];
+    }
+    cout << " kept " << total.kept << " F " << total.speed << " T " << total.jumps << "\n";
+    return;
+}
@@ -0,0 +1,392 @@
+// REPLAY CORPUS: replays of the live games packed into shards that readers map whole, with an
+// index of every game at the front for iterating and sampling games and ticks
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "rules.h"
+
+using namespace std;
+
+// Constant: Replay layout the live games write (see their Replays section): the version, the
+// footer, and the flag and kept cursor of 4-bit input records
+const int REPLAY_VERSION = 3;
+const uint32_t REPLAY_FOOTER = 32;
+const int REPLAY_FLAG = 8;
+const int REPLAY_KEEP = 0;
+
+// Constant: Event codes of flagged records, F toggled the speed and T teleported
+const int REPLAY_SPEED = 1;
+const int REPLAY_JUMP = 2;
+
+// Constant: Shard magic ("SNKC") and layout version
+const uint32_t CORPUS_MAGIC = 0x434B4E53;
+const uint32_t CORPUS_VERSION = 1;
+
+// Constant: Byte the index of a shard starts at, past its header
+const uint64_t CORPUS_INDEX = 64;
+
+// Constant: Games a new shard has room for, its index is left sparse until used
+const uint64_t CORPUS_CAPACITY = 1 << 20;
+
+// Data type: Start of a shard. The index follows it, capacity entries, then the replays back
+// to back from data_at. A writer appends the replay, then its entry, then raises games, so a
+// reader that loads games sees whole games only
+struct corpus_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    uint64_t games;
+    uint64_t data_at;
+    // Byte where the next replay goes
+    uint64_t end;
+};
+
+// Data type: Index entry of one game, its final score and size and the ticks it lasted
+struct corpus_entry
+{
+    uint64_t offset;
+    uint32_t length;
+    uint32_t variant;
+    uint32_t seed;
+    int32_t score;
+    uint32_t ticks;
+    int32_t size;
+};
+
+// Data type: Shard mapped for reading, shared by every reader thread. Holds the games written
+// when it was opened and the ticks ahead of each for sampling
+struct corpus
+{
+    const uint8_t *base;
+    size_t bytes;
+    const corpus_entry *entries;
+    uint64_t games;
+    uint64_t ticks;
+    vector<uint64_t> first_tick;
+};
+
+// Data type: One tick of a game: the arrow the cursor took (index in KEYS, -1 for a cursor
+// kept that is no arrow), the events of the flagged records ahead of it as bits of their
+// codes, and the keyframe of its run, the state before the first tick of the run
+struct corpus_tick
+{
+    uint64_t game;
+    uint32_t tick;
+    int arrow;
+    int events;
+    const uint8_t *keyframe;
+    uint32_t keyframe_bytes;
+};
+
+// Data type: Reader of the ticks of one game, from a keyframe on
+struct replay_cursor
+{
+    const uint8_t *replay;
+    uint64_t game;
+    int bits;
+    // Ticks between keyframes, the keyframes and the byte their offsets start at
+    uint32_t every;
+    uint32_t keyframes;
+    uint32_t index;
+    uint32_t ticks;
+    // Next tick and the bit its records start at
+    uint32_t tick;
+    uint64_t bit;
+    const uint8_t *keyframe;
+    uint32_t keyframe_bytes;
+};
+
+// Read a 32-bit value low byte first
+inline uint32_t read32(const uint8_t *at)
+{
+    return at[0] | (at[1] << 8) | (at[2] << 16) | ((uint32_t) at[3] << 24);
+}
+
+// Read a number the games keep in 7-bit groups, sign lowest, false if it runs past end
+inline bool read_number(const uint8_t *data, uint64_t end, uint64_t *at, long *value)
+{
+    uint64_t bits = 0;
+    for (int shift = 0; *at < end && shift < 64; shift += 7)
+    {
+        uint8_t group = data[(*at)++];
+        bits |= (uint64_t) (group & 0x7F) << shift;
+        if (!(group & 0x80))
+        {
+            *value = (bits & 1) ? ~(long) (bits >> 1) : (long) (bits >> 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Index entry of a replay, its offset left to the writer. False unless it is a whole replay:
+// header, keyframe index and footer where they belong
+inline bool replay_entry(const uint8_t *replay, uint64_t length, corpus_entry *e)
+{
+    if (length < 8 || memcmp(replay, "SNKR", 4) != 0 || replay[4] != REPLAY_VERSION || replay[5] >= VARIANTS
+        || (replay[6] != 2 && replay[6] != 4))
+    {
+        return false;
+    }
+    uint64_t header = 8 + 4 * replay[7] + 8;
+    if (length < header + REPLAY_FOOTER || length > UINT32_MAX)
+    {
+        return false;
+    }
+    const uint8_t *footer = replay + length - REPLAY_FOOTER;
+    uint64_t keyframes = read32(footer + 4);
+    uint64_t index = read32(footer + 8);
+    if (memcmp(footer, "SNKE", 4) != 0 || keyframes == 0 || read32(replay + header - 4) == 0 || index < header
+        || index + 4 * keyframes + REPLAY_FOOTER != length)
+    {
+        return false;
+    }
+    e->length = length;
+    e->variant = replay[5];
+    e->seed = read32(replay + header - 8);
+    e->ticks = read32(footer + 12);
+    e->score = read32(footer + 16);
+    e->size = read32(footer + 20);
+    return true;
+}
+
+// Write all of data at an offset of a file
+inline bool write_at(int fd, const void *data, size_t bytes, uint64_t at)
+{
+    const uint8_t *from = (const uint8_t *) data;
+    while (bytes > 0)
+    {
+        ssize_t n = pwrite(fd, from, bytes, at);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        from += n;
+        bytes -= n;
+        at += n;
+    }
+    return true;
+}
+
+// Open a shard to append to, created with room for capacity games if it does not exist, and
+// lock it against other writers until close_writer. Readers need no lock. -1 on failure
+inline int open_writer(const char *path, uint64_t capacity, corpus_header *h)
+{
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    struct stat st;
+    if (flock(fd, LOCK_EX) < 0 || fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0)
+    {
+        *h = {};
+        h->magic = CORPUS_MAGIC;
+        h->version = CORPUS_VERSION;
+        h->capacity = capacity;
+        h->games = 0;
+        h->data_at = (CORPUS_INDEX + capacity * sizeof(corpus_entry) + 4095) / 4096 * 4096;
+        h->end = h->data_at;
+        if (capacity > 0 && ftruncate(fd, h->data_at) == 0 && write_at(fd, h, sizeof(*h), 0))
+        {
+            return fd;
+        }
+    }
+    else if (pread(fd, h, sizeof(*h), 0) == sizeof(*h) && h->magic == CORPUS_MAGIC && h->version == CORPUS_VERSION)
+    {
+        return fd;
+    }
+    close(fd);
+    return -1;
+}
+
+// Append one replay, false if it is none or the shard is full
+inline bool append_replay(int fd, corpus_header *h, const uint8_t *replay, uint64_t length)
+{
+    corpus_entry e = {};
+    if (h->games >= h->capacity || !replay_entry(replay, length, &e))
+    {
+        return false;
+    }
+    e.offset = h->end;
+    if (!write_at(fd, replay, length, e.offset) || !write_at(fd, &e, sizeof(e), CORPUS_INDEX + h->games * sizeof(e)))
+    {
+        return false;
+    }
+    h->end += length;
+    h->games++;
+    return write_at(fd, h, sizeof(*h), 0);
+}
+
+// Unlock a shard and close it
+inline void close_writer(int fd)
+{
+    flock(fd, LOCK_UN);
+    close(fd);
+    return;
+}
+
+// Map a shard for reading, false unless it is one. Games appended later are left out
+inline bool open_corpus(const char *path, corpus *c)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(corpus_header))
+    {
+        close(fd);
+        return false;
+    }
+    void *region = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED)
+    {
+        return false;
+    }
+    c->base = (const uint8_t *) region;
+    c->bytes = st.st_size;
+    const corpus_header *h = (const corpus_header *) region;
+    if (h->magic != CORPUS_MAGIC || h->version != CORPUS_VERSION || h->data_at > c->bytes
+        || CORPUS_INDEX + h->capacity * sizeof(corpus_entry) > h->data_at)
+    {
+        munmap(region, c->bytes);
+        return false;
+    }
+    c->entries = (const corpus_entry *) (c->base + CORPUS_INDEX);
+    c->games = min(__atomic_load_n(&h->games, __ATOMIC_ACQUIRE), h->capacity);
+    // A writer may have gone on past the size mapped
+    for (uint64_t g = 0; g < c->games; g++)
+    {
+        if (c->entries[g].offset + c->entries[g].length > c->bytes)
+        {
+            c->games = g;
+        }
+    }
+    c->first_tick.assign(c->games + 1, 0);
+    for (uint64_t g = 0; g < c->games; g++)
+    {
+        c->first_tick[g + 1] = c->first_tick[g] + c->entries[g].ticks;
+    }
+    c->ticks = c->first_tick[c->games];
+    return true;
+}
+
+// Unmap a shard
+inline void close_corpus(corpus *c)
+{
+    munmap((void *) c->base, c->bytes);
+    c->base = NULL;
+    return;
+}
+
+// Read the next tick of a game, false past its last one or on a keyframe out of place
+inline bool next_tick(replay_cursor *r, corpus_tick *t)
+{
+    if (r->tick >= r->ticks)
+    {
+        return false;
+    }
+    if (r->tick % r->every == 0)
+    {
+        uint32_t k = r->tick / r->every;
+        uint64_t at = (r->bit + 7) / 8;
+        long length;
+        if (k >= r->keyframes || read32(r->replay + r->index + 4 * k) != at
+            || !read_number(r->replay, r->index, &at, &length) || length < 0 || at + length > r->index)
+        {
+            return false;
+        }
+        r->keyframe = r->replay + at;
+        r->keyframe_bytes = length;
+        r->bit = (at + length) * 8;
+    }
+    int events = 0;
+    while (r->bit + r->bits <= (uint64_t) r->index * 8)
+    {
+        int record = (r->replay[r->bit / 8] >> (r->bit % 8)) & ((1 << r->bits) - 1);
+        r->bit += r->bits;
+        if (r->bits == 4 && (record & REPLAY_FLAG) && record != (REPLAY_FLAG | REPLAY_KEEP))
+        {
+            events |= 1 << (record & ~REPLAY_FLAG);
+            continue;
+        }
+        t->game = r->game;
+        t->tick = r->tick++;
+        t->arrow = (r->bits == 4 && record == (REPLAY_FLAG | REPLAY_KEEP)) ? -1 : record;
+        t->events = events;
+        t->keyframe = r->keyframe;
+        t->keyframe_bytes = r->keyframe_bytes;
+        return true;
+    }
+    return false;
+}
+
+// Point a cursor at a tick of a game: at the keyframe before it, then on over the ticks
+// between, fewer than the keyframe interval
+inline bool seek_tick(const corpus &c, uint64_t game, uint32_t tick, replay_cursor *r)
+{
+    if (game >= c.games || tick >= c.entries[game].ticks)
+    {
+        return false;
+    }
+    const corpus_entry &e = c.entries[game];
+    r->replay = c.base + e.offset;
+    r->game = game;
+    r->bits = r->replay[6];
+    uint32_t header = 8 + 4 * r->replay[7] + 8;
+    const uint8_t *footer = r->replay + e.length - REPLAY_FOOTER;
+    r->every = read32(r->replay + header - 4);
+    r->keyframes = read32(footer + 4);
+    r->index = read32(footer + 8);
+    r->ticks = e.ticks;
+    uint32_t k = min(tick / r->every, r->keyframes - 1);
+    r->tick = k * r->every;
+    r->bit = (uint64_t) read32(r->replay + r->index + 4 * k) * 8;
+    corpus_tick skipped;
+    while (r->tick < tick)
+    {
+        if (!next_tick(r, &skipped))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A tick drawn evenly from every tick of the shard
+inline bool sample_tick(const corpus &c, uint64_t *seed, corpus_tick *t)
+{
+    if (c.ticks == 0)
+    {
+        return false;
+    }
+    uint64_t n = next_random(seed) % c.ticks;
+    uint64_t game = upper_bound(c.first_tick.begin(), c.first_tick.end(), n) - c.first_tick.begin() - 1;
+    replay_cursor r;
+    return seek_tick(c, game, n - c.first_tick[game], &r) && next_tick(&r, t);
+}
+
+#endif
@@ -0,0 +1,234 @@
+// OBSERVATION ENCODER: batched games as multi-channel planes for learning agents
+#ifndef ENCODE_H
+#define ENCODE_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "batch.h"
+
+// Channels of an encoded game, each one value per cell
+enum channel
+{
+    BODY_CHANNEL,
+    HEAD_CHANNEL,
+    APPLE_CHANNEL,
+    BANANA_CHANNEL,
+    TRAP_CHANNEL,
+    PORTAL_CHANNEL,
+    // Age of the apple, banana or trap on the cell over age_horizon
+    AGE_CHANNEL,
+    // Moves left saturating towards 1, half at the starting moves, the same on every cell
+    MOVES_CHANNEL,
+    CHANNELS
+};
+
+// Element types: uint8 scales 1.0 to 255
+enum tensor_type
+{
+    NO_TENSOR,
+    TENSOR_U8,
+    TENSOR_F32
+};
+
+// Layouts of one game: channel planes (CHW) or the channels of a cell together (HWC)
+enum tensor_layout
+{
+    CHW,
+    HWC
+};
+
+// Constant: Age horizon of variants whose traps never expire
+const int AGE_HORIZON = 32;
+
+// Data type: How games are encoded
+struct encoding
+{
+    int type;
+    int layout;
+    // Ages read as 1 from here on
+    int age_horizon;
+    // Moves read as 0.5, 0 for unlimited moves
+    int moves_horizon;
+};
+
+// Encoding of a variant, ages run to the trap life when traps expire
+inline encoding make_encoding(const rules &r, int type, int layout)
+{
+    encoding e;
+    e.type = type;
+    e.layout = layout;
+    e.age_horizon = (r.traps && r.trap_life > 0) ? r.trap_life : AGE_HORIZON;
+    e.moves_horizon = r.moves;
+    return e;
+}
+
+// Bytes of one encoded game
+inline size_t tensor_bytes(const encoding &e, int cells)
+{
+    return (size_t) CHANNELS * cells * (e.type == TENSOR_F32 ? sizeof(float) : sizeof(uint8_t));
+}
+
+// Data type: The first six float channels of a cell for each of the 32 item bit combinations,
+// an HWC cell is one table load plus the age and moves
+struct spread_table
+{
+    float f32[32][CHANNELS];
+};
+
+// Fill the table
+inline spread_table make_spreads()
+{
+    spread_table t;
+    const uint8_t bits[] = {BODY, 0, APPLE, BANANA, SNARE, PORTAL};
+    for (int i = 0; i < 32; i++)
+    {
+        for (int k = 0; k < CHANNELS; k++)
+        {
+            bool on = k < AGE_CHANNEL && (i & bits[k]) != 0;
+            t.f32[i][k] = on ? 1.0f : 0.0f;
+        }
+    }
+    return t;
+}
+
+// Table built on first use
+inline const spread_table &spreads()
+{
+    static const spread_table t = make_spreads();
+    return t;
+}
+
+// Age of the item on a cell clamped to 0 .. horizon, 0 for cells without an aging item
+inline int clamp_age(uint8_t item, int16_t age, int horizon)
+{
+    int a = age < 0 ? 0 : age;
+    a = a > horizon ? horizon : a;
+    return (item & AGING) ? a : 0;
+}
+
+// One board as uint8 planes, every loop is a straight pass over the cells and vectorizes
+// (HWC builds the eight bytes of a cell in one 64 bit lane); age * scale is fixed point
+// with 8 fraction bits. Writing the planes is bound by memory bandwidth, the reads stay in L1
+inline void encode_cells(int cells, const uint8_t *__restrict item, const int16_t *__restrict age, int head,
+                         float moves, const encoding &e, uint8_t *__restrict out)
+{
+    const int horizon = e.age_horizon;
+    const int scale = (255 * 256 + horizon / 2) / horizon;
+    const uint8_t left = (uint8_t) (moves * 255 + 0.5f);
+    if (e.layout == CHW)
+    {
+        const uint8_t bits[] = {BODY, 0, APPLE, BANANA, SNARE, PORTAL};
+        for (int k = 0; k < AGE_CHANNEL; k++)
+        {
+            uint8_t *__restrict plane = out + k * cells;
+            const uint8_t bit = bits[k];
+            for (int c = 0; c < cells; c++)
+            {
+                plane[c] = (item[c] & bit) ? 255 : 0;
+            }
+        }
+        uint8_t *__restrict aged = out + AGE_CHANNEL * cells;
+        for (int c = 0; c < cells; c++)
+        {
+            aged[c] = (uint8_t) ((clamp_age(item[c], age[c], horizon) * scale + 128) >> 8);
+        }
+        memset(out + MOVES_CHANNEL * cells, left, cells);
+        out[HEAD_CHANNEL * cells + head] = 255;
+    }
+    else
+    {
+        // Flag k lands on bit 0 of byte k, times 255 fills the byte
+        const uint64_t rest = (uint64_t) left << (8 * MOVES_CHANNEL);
+        for (int c = 0; c < cells; c++)
+        {
+            uint64_t it = item[c];
+            uint64_t a = (clamp_age(item[c], age[c], horizon) * scale + 128) >> 8;
+            uint64_t v = (it & BODY) | ((it >> 1) & 1) << (8 * APPLE_CHANNEL) | ((it >> 2) & 1) << (8 * BANANA_CHANNEL)
+                       | ((it >> 3) & 1) << (8 * TRAP_CHANNEL) | ((it >> 4) & 1) << (8 * PORTAL_CHANNEL);
+            v = v * 255 | a << (8 * AGE_CHANNEL) | rest;
+            memcpy(out + c * CHANNELS, &v, sizeof(v));
+        }
+        out[head * CHANNELS + HEAD_CHANNEL] = 255;
+    }
+    return;
+}
+
+// One board as float32 planes
+inline void encode_cells(int cells, const uint8_t *__restrict item, const int16_t *__restrict age, int head,
+                         float moves, const encoding &e, float *__restrict out)
+{
+    const int horizon = e.age_horizon;
+    const float scale = 1.0f / horizon;
+    if (e.layout == CHW)
+    {
+        const uint8_t bits[] = {BODY, 0, APPLE, BANANA, SNARE, PORTAL};
+        for (int k = 0; k < AGE_CHANNEL; k++)
+        {
+            float *__restrict plane = out + k * cells;
+            const uint8_t bit = bits[k];
+            for (int c = 0; c < cells; c++)
+            {
+                plane[c] = (item[c] & bit) ? 1.0f : 0.0f;
+            }
+        }
+        float *__restrict aged = out + AGE_CHANNEL * cells;
+        float *__restrict left = out + MOVES_CHANNEL * cells;
+        for (int c = 0; c < cells; c++)
+        {
+            aged[c] = clamp_age(item[c], age[c], horizon) * scale;
+            left[c] = moves;
+        }
+        out[HEAD_CHANNEL * cells + head] = 1.0f;
+    }
+    else
+    {
+        const spread_table &t = spreads();
+        for (int c = 0; c < cells; c++)
+        {
+            float *__restrict cell = out + c * CHANNELS;
+            memcpy(cell, t.f32[item[c] & 31], sizeof(t.f32[0]));
+            cell[AGE_CHANNEL] = clamp_age(item[c], age[c], horizon) * scale;
+            cell[MOVES_CHANNEL] = moves;
+        }
+        out[head * CHANNELS + HEAD_CHANNEL] = 1.0f;
+    }
+    return;
+}
+
+// Encode game g of a batch into out, tensor_bytes(e, b.cells) bytes
+inline void encode_game(const batch &b, int g, const encoding &e, void *out)
+{
+    size_t base = (size_t) g * b.cells;
+    int head = b.head_y[g] * b.r.columns + b.head_x[g];
+    float moves = 0;
+    if (e.moves_horizon > 0)
+    {
+        // Saturating instead of clamped, a well fed snake runs to several times the starting
+        // moves and still reads apart from one that just got them
+        float left = b.moves[g] < 0 ? 0 : (float) b.moves[g];
+        moves = left / (left + e.moves_horizon);
+    }
+    if (e.type == TENSOR_F32)
+    {
+        encode_cells(b.cells, &b.item[base], &b.age[base], head, moves, e, (float *) out);
+    }
+    else
+    {
+        encode_cells(b.cells, &b.item[base], &b.age[base], head, moves, e, (uint8_t *) out);
+    }
+    return;
+}
+
+// Encode every game of a batch back to back into out, games * tensor_bytes(e, b.cells) bytes
+inline void encode_batch(const batch &b, const encoding &e, void *out)
+{
+    size_t bytes = tensor_bytes(e, b.cells);
+    for (int g = 0; g < b.games; g++)
+    {
+        encode_game(b, g, e, (uint8_t *) out + g * bytes);
+    }
+    return;
+}
+
+#endif
@@ -1,9 +1,14 @@
 #include <cctype>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <limits>
+#include <string>
+#include <unistd.h>
 
 using namespace std;
 
@@ -34,6 +39,55 @@ const int ROWS = 15;
 // Global variable: 2D Grid of tiles
 tile GRID[ROWS][COLUMNS];
 
+// Global variable: Batch mode runs scripted moves without screen or prompt
+bool BATCH = false;
+
+// Global variable: Autopilot picks the moves instead of the prompt
+bool AUTO = false;
+
+// Constant: Autopilot moves, the keys and the steps they take on the walled grid
+const int PILOT_DIRECTIONS = 4;
+const int PILOT_WIDTH = COLUMNS + 2;
+const int PILOT_CELLS = (ROWS + 2) * PILOT_WIDTH;
+const char PILOT_KEYS[] = "RCDF";
+const int PILOT_STEP[] = {-PILOT_WIDTH, PILOT_WIDTH, -1, 1};
+
+// Constant: Steps a room holds the head per cell while the body moves off beside it
+const int ROOM_HOLD = 4;
+
+// Global variables: Autopilot scratch allocated once, the grid with a wall border where
+// cell (x, y) is (y + 1) * PILOT_WIDTH + x + 1, the search queue, the first move towards
+// every reached cell and visit stamps that clear by bumping PILOT_STAMP
+bool PILOT_WALL[PILOT_CELLS];
+bool PILOT_GOAL[PILOT_CELLS];
+int PILOT_QUEUE[PILOT_CELLS];
+int PILOT_FIRST[PILOT_CELLS];
+unsigned PILOT_SEEN[PILOT_CELLS];
+unsigned PILOT_STAMP = 0;
+
+// Global variable: Body segment on each autopilot cell counted from the tail, -1 off the body
+int PILOT_ORDER[PILOT_CELLS];
+
+// Global variables: Cell of each body segment counted from the tail, how many there are,
+// and the stamp of the last search that ran into each of them
+int PILOT_BODY[PILOT_CELLS];
+int PILOT_LENGTH = 0;
+unsigned PILOT_TOUCHED[PILOT_CELLS];
+
+// Global variable: Autopilot follows a Hamiltonian cycle, cutting ahead where it is safe
+bool CYCLE = false;
+
+// Global variables: Cycle tables built once, the place on the cycle of every walled cell
+// (-1 on the border), the number of cells on the cycle, the corner odd grids leave off it
+// (-1 if none) and its diagonal neighbour, whose place on the cycle it shares
+int CYCLE_INDEX[PILOT_CELLS];
+int CYCLE_LENGTH = 0;
+int CYCLE_CORNER = -1;
+int CYCLE_TWIN = -1;
+
+// Global variable: Walled cell of the apple on the grid
+int APPLE_CELL = -1;
+
 // Prototypes
 void spawn_apple(void);
 void default_grid(void);
@@ -46,15 +100,89 @@ void move_snake(node *tail);
 void move_node(node *n);
 void lead_node(node *n);
 void crash(void);
+void win(void);
 bool intersect(node *head, node *tail);
 bool eat(node *head);
-void sizeup(node **tail);
+void sizeup(node **tail, int x, int y);
 void lfree(node *tail);
-
-int main(void)
+bool load_moves(const char *path, string *stream);
+char next_move(const string &stream, size_t *at, char inertia);
+void pilot_grid(node *tail);
+void next_stamp(void);
+int flood(int start, int limit);
+int escape(int start, int limit);
+char autopilot(node *head, node *tail, char inertia, int size);
+void build_cycle(void);
+void number_cell(bool rows, int lane, int at, int *k);
+int ahead(int from, int to);
+char cycle_pilot(node *head, node *tail, char inertia, int size);
+
+int main(int argc, char *argv[])
 {
+    // Options: -b FILE plays the moves in FILE (- for stdin) in batch mode,
+    // -a TURNS lets the autopilot play up to TURNS moves in batch mode (0 until the game ends),
+    // -c makes the autopilot follow a Hamiltonian cycle until the grid is full,
+    // -l logs every batch turn, -s SEED fixes the random seed
+    const char *script = NULL;
+    long limit = 0;
+    bool log = false;
+    unsigned seed = time(NULL);
+    int opt;
+    while ((opt = getopt(argc, argv, "a:b:cls:")) != -1)
+    {
+        if (opt == 'a')
+        {
+            AUTO = true;
+            limit = atol(optarg);
+        }
+        else if (opt == 'b')
+        {
+            script = optarg;
+        }
+        else if (opt == 'c')
+        {
+            AUTO = true;
+            CYCLE = true;
+        }
+        else if (opt == 'l')
+        {
+            log = true;
+        }
+        else if (opt == 's')
+        {
+            seed = strtoul(optarg, NULL, 10);
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-a TURNS] [-c] | [-b FILE] [-l] [-s SEED]\n";
+            return 1;
+        }
+    }
+
+    // Load the whole move stream up front for batch mode
+    string stream;
+    size_t at = 0;
+    if (script != NULL)
+    {
+        if (!load_moves(script, &stream))
+        {
+            cerr << "Cannot read moves from " << script << "\n";
+            return 1;
+        }
+        BATCH = true;
+    }
+    // The autopilot plays unattended like a batch run
+    if (AUTO)
+    {
+        BATCH = true;
+    }
+    if (CYCLE)
+    {
+        build_cycle();
+    }
+
     // Seed for random coordinate GENERATION
-    srand(time(NULL));
+    srand(seed);
 
     // Default head node setup
     node *head = new node;
@@ -72,6 +200,9 @@ int main(void)
     // Snake initial size
     int size = 1;
     char inertia = 'X'; // Initial inertia to the invariant direction
+    // Turns played and how the game ended
+    long turns = 0;
+    const char *end = "input";
 
     // Loop game
     while (true)
@@ -80,47 +211,87 @@ int main(void)
         default_grid();
         // Updete grid with snake positions
         update_grid(tail);
+        // A full grid has no room left for an apple, the game is won
+        if (ate && size == ROWS * COLUMNS)
+        {
+            if (!BATCH && !print_grid(size - 1))
+            {
+                lfree(tail);
+                return 1;
+            }
+            end = "full";
+            win();
+            break;
+        }
         // Spawn an apple if no apple left on grid
         if (ate)
         {
             spawn_apple();
         }
         // Print grid with snake and apple positions
-        if (!print_grid(size - 1))
+        if (!BATCH && !print_grid(size - 1))
         {
             lfree(tail);
             return 1;
         }
 
-        // Prompt user for valid key input for cursor
         char cursor;
-        do 
+        if (AUTO)
+        {
+            // Autopilot move, stop after the asked turns
+            if (limit > 0 && turns >= limit)
+            {
+                end = "turns";
+                break;
+            }
+            cursor = CYCLE ? cycle_pilot(head, tail, inertia, size) : autopilot(head, tail, inertia, size);
+        }
+        else if (BATCH)
+        {
+            // Take the next move the prompt would accept, stop when the stream runs out
+            cursor = next_move(stream, &at, inertia);
+            if (cursor == 0)
+            {
+                break;
+            }
+        }
+        else
         {
-            cout << "(Up: R | Down: C | <-: D | ->: F): ";
-            cin >> cursor;
-            // Convert to uppercase
-            cursor = static_cast <char> (toupper(cursor));
+            // Prompt user for valid key input for cursor
+            do 
+            {
+                cout << "(Up: R | Down: C | <-: D | ->: F): ";
+                cin >> cursor;
+                // Convert to uppercase
+                cursor = static_cast <char> (toupper(cursor));
 
-            // Clear any extra input from the buffer
-            cin.ignore (numeric_limits <streamsize> :: max(), '\n');
+                // Clear any extra input from the buffer
+                cin.ignore (numeric_limits <streamsize> :: max(), '\n');
+            }
+            while ((cursor != 'R' && cursor != 'C' && cursor != 'F' && cursor != 'D') || cursor == inertia);
         }
-        while ((cursor != 'R' && cursor != 'C' && cursor != 'F' && cursor != 'D') || cursor == inertia);
+        turns++;
 
         inertia = backwards(cursor);
         // Change head direction using cursor input
         point_head(cursor, head);
+        // Cell the tail leaves, the snake grows into it
+        int last_x = tail->x;
+        int last_y = tail->y;
         // Move snake nodes towards their directions and updating directions
         move_snake(tail);
 
         // Crash if head hits boundary
         if (head->x < 0 || head->x >= COLUMNS || head->y < 0 || head->y >= ROWS)
         {
+            end = "boundary";
             crash();
             break;
         }
         // Crash if head hits snake body
         else if (intersect(head, tail))
         {
+            end = "self";
             crash();
             break;
         }
@@ -130,7 +301,7 @@ int main(void)
             GRID[head->y][head->x].apple = false;
             ate = true;
 
-            sizeup(&tail);
+            sizeup(&tail, last_x, last_y);
             size++;
         }
         // Next turn
@@ -138,6 +309,18 @@ int main(void)
         {
             ate = false;
         }
+
+        // Compact batch log: turn, move, head x, head y, size, score
+        if (log)
+        {
+            cout << turns << ' ' << cursor << ' ' << head->x << ' ' << head->y << ' ' << size << ' ' << size - 1 << '\n';
+        }
+    }
+
+    // Batch result
+    if (BATCH)
+    {
+        cout << "turns " << turns << " size " << size << " score " << size - 1 << " end " << end << "\n";
     }
 
     // Recursively free the snake list
@@ -157,6 +340,7 @@ void spawn_apple(void)
     while (GRID[y][x].snake); // Avoid snake positions
 
     GRID[y][x].apple = true;
+    APPLE_CELL = (y + 1) * PILOT_WIDTH + x + 1;
     return;
 }
 
@@ -336,7 +520,19 @@ void lead_node(node *n)
 // Crash statement protocols
 void crash(void)
 {
-    cout << "Game over!!\n";
+    if (!BATCH)
+    {
+        cout << "Game over!!\n";
+    }
+}
+
+// Win statement protocols
+void win(void)
+{
+    if (!BATCH)
+    {
+        cout << "Grid full, you win!!\n";
+    }
 }
 
 // Check if head hits snake body
@@ -366,60 +562,409 @@ bool eat(node *head)
     }
 }
 
-// Upgarde snake list by appending node to the tail
-void sizeup(node **tail)
+// Upgarde snake list by appending node to the tail on cell (x, y) it just left
+void sizeup(node **tail, int x, int y)
 {
     node *t = *tail;
 
     // Allocate a new node
     node *n = new node;
 
-    // On grid, Place new node behind tail node
+    // On grid, Place new node on the cell the tail left, heading into the tail,
+    // behind the tail by its new direction lands on the body or off the grid at a bend
     n->prev = NULL;
-    if (t->axis)
+    n->x = x;
+    n->y = y;
+    n->axis = (t->x == x);
+    n->direction = (t->x > x || t->y > y);
+
+    // Append new node to tail without orphaning
+    n->prev = t;
+    *tail = n;
+
+    return;
+}
+
+// Recursively free snake link list
+void lfree(node *tail)
+{
+    if (tail == NULL)
     {
-        if (t->direction)
+        return;
+    }
+
+    lfree(tail->prev);
+    delete tail;
+    return;
+}
+
+// Batch mode
+
+// Read the whole move stream into memory
+bool load_moves(const char *path, string *stream)
+{
+    if (strcmp(path, "-") == 0)
+    {
+        stream->assign(istreambuf_iterator <char> (cin), istreambuf_iterator <char> ());
+        return true;
+    }
+
+    ifstream script(path, ios::binary);
+    if (!script)
+    {
+        return false;
+    }
+    stream->assign(istreambuf_iterator <char> (script), istreambuf_iterator <char> ());
+    return true;
+}
+
+// Next move in the stream the prompt would accept, 0 when the stream runs out
+// Every letter is one move, whitespace and rejected letters are skipped
+char next_move(const string &stream, size_t *at, char inertia)
+{
+    while (*at < stream.size())
+    {
+        char cursor = static_cast <char> (toupper(stream[(*at)++]));
+        if ((cursor == 'R' || cursor == 'C' || cursor == 'F' || cursor == 'D') && cursor != inertia)
         {
-            n->y = t->y - 1;
+            return cursor;
         }
-        else
+    }
+    return 0;
+}
+
+// Autopilot
+
+// Copy the grid into the walled autopilot grid: snake cells and the border are walls,
+// the tail cell is free since the tail moves on first, apples are goals
+void pilot_grid(node *tail)
+{
+    for (int c = 0; c < PILOT_CELLS; c++)
+    {
+        PILOT_WALL[c] = true;
+        PILOT_GOAL[c] = false;
+        PILOT_ORDER[c] = -1;
+    }
+    for (int y = 0; y < ROWS; y++)
+    {
+        for (int x = 0; x < COLUMNS; x++)
         {
-            n->y = t->y + 1;
+            int c = (y + 1) * PILOT_WIDTH + x + 1;
+            PILOT_WALL[c] = GRID[y][x].snake;
+            PILOT_GOAL[c] = GRID[y][x].apple;
         }
-        n->x = t->x;
     }
-    else
+    // Segments in the order they move off
+    int order = 0;
+    for (node *ptr = tail; ptr != NULL; ptr = ptr->prev)
+    {
+        PILOT_BODY[order] = (ptr->y + 1) * PILOT_WIDTH + ptr->x + 1;
+        PILOT_ORDER[PILOT_BODY[order]] = order;
+        order++;
+    }
+    PILOT_LENGTH = order;
+    PILOT_WALL[(tail->y + 1) * PILOT_WIDTH + tail->x + 1] = false;
+    return;
+}
+
+// Start a new search, the visit stamps only need clearing when the counter wraps
+void next_stamp(void)
+{
+    PILOT_STAMP++;
+    if (PILOT_STAMP == 0)
+    {
+        memset(PILOT_SEEN, 0, sizeof(PILOT_SEEN));
+        memset(PILOT_TOUCHED, 0, sizeof(PILOT_TOUCHED));
+        PILOT_STAMP = 1;
+    }
+    return;
+}
+
+// Count the free cells reachable from start not visited since the last stamp,
+// stop counting at limit
+int flood(int start, int limit)
+{
+    int front = 0;
+    int back = 0;
+    PILOT_SEEN[start] = PILOT_STAMP;
+    PILOT_QUEUE[back++] = start;
+    while (front < back && back < limit)
     {
-        if (t->direction)
+        int c = PILOT_QUEUE[front++];
+        for (int d = 0; d < PILOT_DIRECTIONS; d++)
         {
-            n->x = t->x - 1;
+            int n = c + PILOT_STEP[d];
+            if (PILOT_WALL[n] || PILOT_SEEN[n] == PILOT_STAMP)
+            {
+                continue;
+            }
+            PILOT_SEEN[n] = PILOT_STAMP;
+            PILOT_QUEUE[back++] = n;
         }
-        else
+    }
+    return back;
+}
+
+// Count the cells reachable from start like flood, and the body cells next to them once
+// the room can hold the head until they move off: segment i from the tail moves off after
+// i + 1 steps, so the tail cell is free from the start, and a room of n cells holds the
+// head for n / ROOM_HOLD steps. The search stamps the segments it runs into and walks
+// the body once from the tail, each segment it frees carrying the search on from its cell
+int escape(int start, int limit)
+{
+    int front = 0;
+    int back = 0;
+    int freed = 1;
+    PILOT_SEEN[start] = PILOT_STAMP;
+    PILOT_QUEUE[back++] = start;
+    while (back < limit)
+    {
+        while (front < back && back < limit)
+        {
+            int c = PILOT_QUEUE[front++];
+            for (int d = 0; d < PILOT_DIRECTIONS; d++)
+            {
+                int n = c + PILOT_STEP[d];
+                if (PILOT_SEEN[n] == PILOT_STAMP)
+                {
+                    continue;
+                }
+                if (PILOT_WALL[n] && (PILOT_ORDER[n] < 0 || PILOT_ORDER[n] >= freed))
+                {
+                    if (PILOT_ORDER[n] >= 0)
+                    {
+                        PILOT_TOUCHED[PILOT_ORDER[n]] = PILOT_STAMP;
+                    }
+                    continue;
+                }
+                PILOT_SEEN[n] = PILOT_STAMP;
+                PILOT_QUEUE[back++] = n;
+            }
+        }
+        // The segment next to the room that moves off first
+        int next = freed;
+        while (next < PILOT_LENGTH && PILOT_TOUCHED[next] != PILOT_STAMP)
+        {
+            next++;
+        }
+        if (back >= limit || next >= PILOT_LENGTH || next * ROOM_HOLD > back)
         {
-            n->x = t->x + 1;
+            break;
         }
-        n->y = t->y;
+        freed = next + 1;
+        PILOT_SEEN[PILOT_BODY[next]] = PILOT_STAMP;
+        PILOT_QUEUE[back++] = PILOT_BODY[next];
     }
-    // Inherit directions form tail node
-    n->axis = t->axis;
-    n->direction = t->direction;
+    return back;
+}
 
-    // Append new node to tail without orphaning
-    n->prev = t;
-    *tail = n;
+// Autopilot move: breadth-first search to the nearest apple, taken when the snake still
+// fits in the room behind the first step once its body moves off, otherwise the step with
+// the most room
+char autopilot(node *head, node *tail, char inertia, int size)
+{
+    pilot_grid(tail);
+    next_stamp();
+    int front = 0;
+    int back = 0;
+    int start = (head->y + 1) * PILOT_WIDTH + head->x + 1;
+    PILOT_SEEN[start] = PILOT_STAMP;
+    for (int d = 0; d < PILOT_DIRECTIONS; d++)
+    {
+        int n = start + PILOT_STEP[d];
+        if (PILOT_KEYS[d] == inertia || PILOT_WALL[n])
+        {
+            continue;
+        }
+        PILOT_SEEN[n] = PILOT_STAMP;
+        PILOT_FIRST[n] = d;
+        PILOT_QUEUE[back++] = n;
+    }
+    int target = -1;
+    while (front < back)
+    {
+        int c = PILOT_QUEUE[front++];
+        if (PILOT_GOAL[c])
+        {
+            target = c;
+            break;
+        }
+        for (int d = 0; d < PILOT_DIRECTIONS; d++)
+        {
+            int n = c + PILOT_STEP[d];
+            if (PILOT_WALL[n] || PILOT_SEEN[n] == PILOT_STAMP)
+            {
+                continue;
+            }
+            PILOT_SEEN[n] = PILOT_STAMP;
+            PILOT_FIRST[n] = PILOT_FIRST[c];
+            PILOT_QUEUE[back++] = n;
+        }
+    }
+    if (target >= 0)
+    {
+        int d = PILOT_FIRST[target];
+        next_stamp();
+        PILOT_SEEN[start] = PILOT_STAMP;
+        if (escape(start + PILOT_STEP[d], size + 1) > size)
+        {
+            return PILOT_KEYS[d];
+        }
+    }
 
-    return;
+    // No apple in reach or no room behind it, one stamp for every step so each
+    // region is counted once, a step into a counted region has no more room
+    int best = -1;
+    int room = 0;
+    next_stamp();
+    PILOT_SEEN[start] = PILOT_STAMP;
+    for (int d = 0; d < PILOT_DIRECTIONS; d++)
+    {
+        int n = start + PILOT_STEP[d];
+        if (PILOT_KEYS[d] == inertia || PILOT_WALL[n] || PILOT_SEEN[n] == PILOT_STAMP)
+        {
+            continue;
+        }
+        int r = flood(n, PILOT_CELLS);
+        if (r > room)
+        {
+            room = r;
+            best = d;
+        }
+    }
+    if (best >= 0)
+    {
+        return PILOT_KEYS[best];
+    }
+    // Boxed in, onto the segment beside the head that moves off first rather than into the
+    // border, any move the prompt accepts when the border is all there is
+    int nearest = -1;
+    for (int d = 0; d < PILOT_DIRECTIONS; d++)
+    {
+        int n = start + PILOT_STEP[d];
+        if (PILOT_KEYS[d] != inertia && PILOT_ORDER[n] >= 0
+            && (nearest < 0 || PILOT_ORDER[n] < PILOT_ORDER[start + PILOT_STEP[nearest]]))
+        {
+            nearest = d;
+        }
+    }
+    if (nearest >= 0)
+    {
+        return PILOT_KEYS[nearest];
+    }
+    return PILOT_KEYS[0] == inertia ? PILOT_KEYS[1] : PILOT_KEYS[0];
 }
 
-// Recursively free snake link list
-void lfree(node *tail)
+// Hamiltonian cycle
+
+// Number the cells along a Hamiltonian cycle. Lanes run back and forth over all but their
+// first cell, the first cells of the lanes lead back to the start, which closes the cycle
+// for an even number of lanes. Lanes run down the columns unless only the rows are even.
+// With both odd the first lane is left out, the second one dips into it two cells at a time
+// on its way down and corner (0, 0) stays off the cycle
+void build_cycle(void)
 {
-    if (tail == NULL)
+    for (int c = 0; c < PILOT_CELLS; c++)
     {
-        return;
+        CYCLE_INDEX[c] = -1;
+    }
+    bool rows = COLUMNS % 2 == 1 && ROWS % 2 == 0;
+    int lanes = rows ? ROWS : COLUMNS;
+    int length = rows ? COLUMNS : ROWS;
+    int first = lanes % 2;
+    int k = 0;
+    for (int lane = first; lane < lanes; lane++)
+    {
+        for (int i = 1; i < length; i++)
+        {
+            int at = ((lane - first) % 2 == 0) ? i : length - i;
+            number_cell(rows, lane, at, &k);
+            if (first == 1 && lane == 1 && at % 2 == 1)
+            {
+                number_cell(rows, 0, at, &k);
+                number_cell(rows, 0, at + 1, &k);
+            }
+        }
+    }
+    for (int lane = lanes - 1; lane >= first; lane--)
+    {
+        number_cell(rows, lane, 0, &k);
     }
+    CYCLE_LENGTH = k;
 
-    lfree(tail->prev);
-    delete tail;
+    // The corner can stand in for cell (1, 1), the cycle always runs through that cell
+    // between the two neighbours of the corner
+    if (first == 1)
+    {
+        CYCLE_CORNER = PILOT_WIDTH + 1;
+        CYCLE_TWIN = 2 * PILOT_WIDTH + 2;
+        CYCLE_INDEX[CYCLE_CORNER] = CYCLE_INDEX[CYCLE_TWIN];
+    }
     return;
-}
\ No newline at end of file
+}
+
+// Give cell at of a lane the next place on the cycle
+void number_cell(bool rows, int lane, int at, int *k)
+{
+    int x = rows ? at : lane;
+    int y = rows ? lane : at;
+    CYCLE_INDEX[(y + 1) * PILOT_WIDTH + x + 1] = (*k)++;
+    return;
+}
+
+// Steps along the cycle from one walled cell to another
+int ahead(int from, int to)
+{
+    return (CYCLE_INDEX[to] - CYCLE_INDEX[from] + CYCLE_LENGTH) % CYCLE_LENGTH;
+}
+
+// Cycle move: every step goes ahead on the cycle without passing the tail, so the body
+// lies on the cycle in order from tail to head and the cells ahead of the head stay free
+// however much it grows. Of those take the step that gets closest to the apple without
+// passing it. The corner off an odd cycle is only entered from the cell before its stand in
+char cycle_pilot(node *head, node *tail, char inertia, int size)
+{
+    int start = (head->y + 1) * PILOT_WIDTH + head->x + 1;
+    int end = (tail->y + 1) * PILOT_WIDTH + tail->x + 1;
+    int room = ahead(start, end);
+    int goal = ahead(start, APPLE_CELL);
+    // A lone head may go anywhere but one step back, which would leave a snake of two
+    // with only the way back, an apple in the corner next to the head is a lap away
+    room = (size == 1) ? CYCLE_LENGTH - 2 : room;
+    goal = (goal == 0) ? CYCLE_LENGTH : goal;
+    // For an apple on the corner or its stand in keep to the cycle, the tail may sit on
+    // the other one whenever the head comes by and a lap without cuts leaves it behind
+    bool paired = CYCLE_CORNER >= 0 && (APPLE_CELL == CYCLE_CORNER || APPLE_CELL == CYCLE_TWIN);
+    int reach = paired ? 1 : goal;
+
+    int best = -1;
+    int score = 0;
+    for (int d = 0; d < PILOT_DIRECTIONS; d++)
+    {
+        int n = start + PILOT_STEP[d];
+        if (PILOT_KEYS[d] == inertia || CYCLE_INDEX[n] < 0)
+        {
+            continue;
+        }
+        // The tail cell is the last one free, of the corner and its stand in sharing its
+        // place the one without the tail is only free for the last apple
+        int step = ahead(start, n);
+        if (step > room || (step == room && n != end && size < CYCLE_LENGTH) || step > reach
+            || (n == CYCLE_CORNER && step != 1))
+        {
+            continue;
+        }
+        int s = 2 * step + (n == APPLE_CELL);
+        if (s > score)
+        {
+            score = s;
+            best = d;
+        }
+    }
+    if (best >= 0)
+    {
+        return PILOT_KEYS[best];
+    }
+    // Off the cycle order, only when the game did not start on it
+    return autopilot(head, tail, inertia, size);
+}
@@ -0,0 +1,247 @@
+// DISTANCE FIELDS: steps from every cell to a set of targets, kept up to date from tick to
+// tick by repairing only the cells a change reaches instead of searching the whole grid
+#ifndef FIELD_H
+#define FIELD_H
+
+#include <algorithm>
+
+#include "board.h"
+
+using namespace std;
+
+// Data type: Cell one step from each cell in each of the 8 directions, -1 off the grid
+struct cell_steps
+{
+    int16_t next[CELLS][8];
+
+    cell_steps()
+    {
+        for (int c = 0; c < CELLS; c++)
+        {
+            for (int d = 0; d < 8; d++)
+            {
+                int x = c % BOARD_COLUMNS + DX[d];
+                int y = c / BOARD_COLUMNS + DY[d];
+                next[c][d] = (x >= 0 && x < BOARD_COLUMNS && y >= 0 && y < BOARD_ROWS) ? y * BOARD_COLUMNS + x : -1;
+            }
+        }
+    }
+};
+
+// Constant: Neighbours shared by the field repairs
+const cell_steps NEXT_CELLS;
+
+// Data type: Steps from each cell to the nearest target, -1 where none can be reached and
+// on every cell off the paths. Paths run through open cells and targets count whatever is
+// on them. Targets can be any plane: apples, bananas or the portal
+struct distance_field
+{
+    int16_t steps[CELLS];
+    bitboard targets;
+    bitboard open;
+    // Directions a step may take, 0 until the field is built
+    int dirs;
+};
+
+// Cell a path can use
+inline bool in_field(const distance_field &f, int cell)
+{
+    return test_bit(f.open, cell) || test_bit(f.targets, cell);
+}
+
+// Search the whole grid, flooding a frontier per round
+inline void build_field(distance_field *f, const bitboard &targets, const bitboard &open, int dirs)
+{
+    f->targets = targets;
+    f->open = open;
+    f->dirs = dirs;
+    for (int c = 0; c < CELLS; c++)
+    {
+        f->steps[c] = -1;
+    }
+    bitboard seen = targets;
+    bitboard frontier = seen;
+    for (int d = 0; !no_bits(frontier); d++)
+    {
+        for (int c = next_bit(frontier, 0); c >= 0; c = next_bit(frontier, c + 1))
+        {
+            f->steps[c] = d;
+        }
+        frontier = without(neighbours(frontier, dirs) & open, seen);
+        seen = seen | frontier;
+    }
+    return;
+}
+
+// A cell joined the paths or became a target: lower the cells that get nearer through it,
+// in breadth first order from the cell
+inline void lower_field(distance_field *f, int cell)
+{
+    int steps = test_bit(f->targets, cell) ? 0 : -1;
+    for (int d = 0; d < f->dirs && steps != 0; d++)
+    {
+        int n = NEXT_CELLS.next[cell][d];
+        if (n >= 0 && f->steps[n] >= 0 && (steps < 0 || f->steps[n] + 1 < steps))
+        {
+            steps = f->steps[n] + 1;
+        }
+    }
+    if (steps < 0 || (f->steps[cell] >= 0 && f->steps[cell] <= steps))
+    {
+        return;
+    }
+    f->steps[cell] = steps;
+    int16_t queue[CELLS];
+    int first = 0;
+    int last = 0;
+    queue[last++] = cell;
+    while (first < last)
+    {
+        int c = queue[first++];
+        for (int d = 0; d < f->dirs; d++)
+        {
+            int n = NEXT_CELLS.next[c][d];
+            if (n >= 0 && in_field(*f, n) && (f->steps[n] < 0 || f->steps[n] > f->steps[c] + 1))
+            {
+                f->steps[n] = f->steps[c] + 1;
+                queue[last++] = n;
+            }
+        }
+    }
+    return;
+}
+
+// A cell left the paths or stopped being a target: find the cells that lose their path,
+// those one step farther whose every neighbour one step nearer lost it too, layer by layer,
+// then search them again from the cells around them that kept their steps
+inline void raise_field(distance_field *f, int cell, int old)
+{
+    if (old < 0)
+    {
+        f->steps[cell] = -1;
+        return;
+    }
+    bitboard lost = {};
+    int16_t queue[CELLS];
+    int first = 0;
+    int last = 0;
+    set_bit(&lost, cell);
+    queue[last++] = cell;
+    while (first < last)
+    {
+        int c = queue[first++];
+        int steps = c == cell ? old : f->steps[c];
+        for (int d = 0; d < f->dirs; d++)
+        {
+            int n = NEXT_CELLS.next[c][d];
+            if (n < 0 || f->steps[n] != steps + 1 || test_bit(lost, n) || test_bit(f->targets, n))
+            {
+                continue;
+            }
+            bool kept = false;
+            for (int e = 0; e < f->dirs && !kept; e++)
+            {
+                int m = NEXT_CELLS.next[n][e];
+                kept = m >= 0 && f->steps[m] == steps && !test_bit(lost, m);
+            }
+            if (!kept)
+            {
+                set_bit(&lost, n);
+                queue[last++] = n;
+            }
+        }
+    }
+
+    // Every lost cell starts from its best neighbour that kept its steps, the starts are
+    // taken in order of their steps merged with the cells they lower
+    int starts[CELLS];
+    int count = 0;
+    for (int i = 0; i < last; i++)
+    {
+        f->steps[queue[i]] = -1;
+    }
+    for (int i = 0; i < last; i++)
+    {
+        int c = queue[i];
+        int steps = -1;
+        for (int d = 0; d < f->dirs && in_field(*f, c); d++)
+        {
+            int n = NEXT_CELLS.next[c][d];
+            if (n >= 0 && f->steps[n] >= 0 && !test_bit(lost, n) && (steps < 0 || f->steps[n] + 1 < steps))
+            {
+                steps = f->steps[n] + 1;
+            }
+        }
+        if (steps >= 0)
+        {
+            starts[count++] = steps * CELLS + c;
+        }
+    }
+    sort(starts, starts + count);
+    first = 0;
+    last = 0;
+    for (int i = 0; i < count || first < last;)
+    {
+        int c;
+        if (i < count && (first == last || starts[i] / CELLS <= f->steps[queue[first]]))
+        {
+            c = starts[i] % CELLS;
+            int steps = starts[i++] / CELLS;
+            if (f->steps[c] >= 0 && f->steps[c] <= steps)
+            {
+                continue;
+            }
+            f->steps[c] = steps;
+        }
+        else
+        {
+            c = queue[first++];
+        }
+        for (int d = 0; d < f->dirs; d++)
+        {
+            int n = NEXT_CELLS.next[c][d];
+            if (n >= 0 && test_bit(lost, n) && in_field(*f, n) && (f->steps[n] < 0 || f->steps[n] > f->steps[c] + 1))
+            {
+                f->steps[n] = f->steps[c] + 1;
+                queue[last++] = n;
+            }
+        }
+    }
+    return;
+}
+
+// Bring a field to new targets and open cells. Between two ticks only the head, the tail,
+// eaten and spawned items and expired traps change, each is repaired on its own; a field
+// not built yet or on other directions is searched whole
+inline void update_field(distance_field *f, const bitboard &targets, const bitboard &open, int dirs)
+{
+    if (f->dirs != dirs)
+    {
+        build_field(f, targets, open, dirs);
+        return;
+    }
+    bitboard was = f->open | f->targets;
+    bitboard now = open | targets;
+    // Losses first: cells leaving the paths, then targets that stay on them
+    bitboard gone = without(was, now) | (without(f->targets, targets) & now);
+    for (int c = next_bit(gone, 0); c >= 0; c = next_bit(gone, c + 1))
+    {
+        int old = f->steps[c];
+        test_bit(open, c) ? set_bit(&f->open, c) : clear_bit(&f->open, c);
+        clear_bit(&f->targets, c);
+        raise_field(f, c, old);
+    }
+    bitboard come = without(now, was) | (without(targets, f->targets) & was);
+    for (int c = next_bit(come, 0); c >= 0; c = next_bit(come, c + 1))
+    {
+        test_bit(open, c) ? set_bit(&f->open, c) : clear_bit(&f->open, c);
+        test_bit(targets, c) ? set_bit(&f->targets, c) : clear_bit(&f->targets, c);
+        lower_field(f, c);
+    }
+    // Cells that changed open while staying targets change no steps
+    f->open = open;
+    f->targets = targets;
+    return;
+}
+
+#endif
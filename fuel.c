@@ -2,7 +2,11 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+
+#include "prices.h"
 
 // Data struct: Node that belong to snake linked list
 typedef struct node
@@ -31,12 +35,51 @@ typedef struct
 #define COLUMNS 25
 #define ROWS 15
 
-// Constant: Trap life span
-#define TRAP_LIFE 125
+// Global variables: Economy of the game, the recharge and reward prices, the trap life
+// span and the starting moves, the prices set from PRICES first thing in main and all of
+// them changed with -P NAME=VALUE
+price_list ECONOMY;
+int TRAP_LIFE = PRICE_TRAP_LIFE;
+int START_MOVES = PRICE_MOVES;
 
 // Global variable: 2D Grid of tiles
 tile GRID[ROWS][COLUMNS];
 
+// Global variable: Batch mode runs scripted moves without screen or prompt
+bool BATCH = false;
+
+// Global variable: Autopilot picks the moves instead of the prompt
+bool AUTO = false;
+
+// Constant: Autopilot moves, the keys and the steps they take on the walled grid
+#define PILOT_DIRECTIONS 4
+#define PILOT_WIDTH (COLUMNS + 2)
+#define PILOT_CELLS ((ROWS + 2) * PILOT_WIDTH)
+const char PILOT_KEYS[] = "RCDF";
+const int PILOT_STEP[] = {-PILOT_WIDTH, PILOT_WIDTH, -1, 1};
+
+// Constant: Steps a room holds the head per cell while the body moves off beside it
+#define ROOM_HOLD 4
+
+// Global variables: Autopilot scratch allocated once, the grid with a wall border where
+// cell (x, y) is (y + 1) * PILOT_WIDTH + x + 1, the search queue, the first move towards
+// every reached cell and visit stamps that clear by bumping PILOT_STAMP
+bool PILOT_WALL[PILOT_CELLS];
+bool PILOT_GOAL[PILOT_CELLS];
+int PILOT_QUEUE[PILOT_CELLS];
+int PILOT_FIRST[PILOT_CELLS];
+unsigned PILOT_SEEN[PILOT_CELLS];
+unsigned PILOT_STAMP = 0;
+
+// Global variable: Body segment on each autopilot cell counted from the tail, -1 off the body
+int PILOT_ORDER[PILOT_CELLS];
+
+// Global variables: Cell of each body segment counted from the tail, how many there are,
+// and the stamp of the last search that ran into each of them
+int PILOT_BODY[PILOT_CELLS];
+int PILOT_LENGTH = 0;
+unsigned PILOT_TOUCHED[PILOT_CELLS];
+
 // Prototypes
 void spawn_apple(void);
 void spawn_trap(void);
@@ -53,16 +96,88 @@ void crash(void);
 bool intersect(node *head, node *tail);
 bool eat(node *head);
 bool hit(node *head);
-bool sizeup(node **tail);
+bool sizeup(node **tail, int x, int y);
 void age(void);
 int recharge(int age);
 int reward(int age);
 void lfree(node *tail);
-
-int main(void)
+char *load_moves(const char *path, long *length);
+char next_move(const char *stream, long length, long *at, char inertia);
+void pilot_grid(node *tail);
+void next_stamp(void);
+int flood(int start, int limit);
+int escape(int start, int limit);
+char autopilot(node *head, node *tail, char inertia, int size);
+
+int main(int argc, char *argv[])
 {
+    ECONOMY = PRICES;
+
+    // Options: -b FILE plays the moves in FILE (- for stdin) in batch mode,
+    // -a TURNS lets the autopilot play up to TURNS moves in batch mode (0 until the game ends),
+    // -l logs every batch turn, -s SEED fixes the random seed, -P NAME=VALUE sets a price, the
+    // trap life or the starting moves by its sweep CSV column
+    const char *script = NULL;
+    long limit = 0;
+    bool log = false;
+    unsigned seed = time(NULL);
+    int opt;
+    while ((opt = getopt(argc, argv, "a:b:ls:P:")) != -1)
+    {
+        if (opt == 'a')
+        {
+            AUTO = true;
+            limit = atol(optarg);
+        }
+        else if (opt == 'b')
+        {
+            script = optarg;
+        }
+        else if (opt == 'l')
+        {
+            log = true;
+        }
+        else if (opt == 's')
+        {
+            seed = strtoul(optarg, NULL, 10);
+        }
+        else if (opt == 'P')
+        {
+            if (!set_price(&ECONOMY, &TRAP_LIFE, &START_MOVES, optarg))
+            {
+                fprintf(stderr, "Bad price %s, expected NAME=VALUE with NAME a sweep CSV column\n", optarg);
+                return 1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-a TURNS | -b FILE] [-l] [-s SEED] [-P NAME=VALUE]...\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Load the whole move stream up front for batch mode
+    char *stream = NULL;
+    long length = 0;
+    long at = 0;
+    if (script != NULL)
+    {
+        stream = load_moves(script, &length);
+        if (stream == NULL)
+        {
+            fprintf(stderr, "Cannot read moves from %s\n", script);
+            return 1;
+        }
+        BATCH = true;
+    }
+    // The autopilot plays unattended like a batch run
+    if (AUTO)
+    {
+        BATCH = true;
+    }
+
     // Seed for random coordinate GENERATION
-    srandom(time(NULL));
+    srandom(seed);
 
     // Default head node setup
     node *head = malloc(sizeof(node));
@@ -86,8 +201,11 @@ int main(void)
     // Initial score
     int score = 0;
     // Initial moves
-    int moves = 50;
+    int moves = START_MOVES;
     char inertia = 'X'; // Initial inertia to the invariant direction
+    // Turns played and how the game ended
+    long turns = 0;
+    const char *end = "moves";
 
     spawn_apple();
 
@@ -106,43 +224,73 @@ int main(void)
         }
 
         // Print grid with snake, trap and apple positions
-        if (!print_grid(score, moves))
+        if (!BATCH && !print_grid(score, moves))
         {
             lfree(tail);
             return 1;
         }
 
-        // Prompt user for valid key input for cursor
         char cursor;
-        do 
+        if (AUTO)
+        {
+            // Autopilot move, stop after the asked turns
+            if (limit > 0 && turns >= limit)
+            {
+                end = "turns";
+                break;
+            }
+            cursor = autopilot(head, tail, inertia, size);
+        }
+        else if (BATCH)
         {
-            printf("(Up: R | Down: C | <-: D | ->: F): ");
-            scanf(" %c", &cursor);
-            cursor = toupper(cursor);
+            // Take the next move the prompt would accept, stop when the stream runs out
+            cursor = next_move(stream, length, &at, inertia);
+            if (cursor == 0)
+            {
+                end = "input";
+                break;
+            }
         }
-        while ((cursor != 'R' && cursor != 'C' && cursor != 'F' && cursor != 'D') || cursor == inertia);
+        else
+        {
+            // Prompt user for valid key input for cursor
+            do 
+            {
+                printf("(Up: R | Down: C | <-: D | ->: F): ");
+                scanf(" %c", &cursor);
+                cursor = toupper(cursor);
+            }
+            while ((cursor != 'R' && cursor != 'C' && cursor != 'F' && cursor != 'D') || cursor == inertia);
+        }
+        turns++;
 
         inertia = backwards(cursor);
         // Change head direction using cursor input
         point_head(cursor, head);
+        // Cell the tail leaves, the snake grows into it
+        int last_x = tail->x;
+        int last_y = tail->y;
         // Move snake nodes towards their directions and updating directions
         move_snake(tail);
 
         // Crash if head hits boundary
         if (head->x < 0 || head->x >= COLUMNS || head->y < 0 || head->y >= ROWS)
         {
+            end = "boundary";
             crash();
             break;
         }
         // Crash if head hits snake body
         else if (intersect(head, tail))
         {
+            end = "self";
             crash();
             break;
         }
         // Crash if head hits trap
         else if (hit(head))
         {
+            end = "trap";
             crash();
             break;
         }
@@ -155,7 +303,7 @@ int main(void)
             GRID[head->y][head->x].apple_age = 0;
             ate = true;
 
-            if (!sizeup(&tail))
+            if (!sizeup(&tail, last_x, last_y))
             {
                 lfree(head);
                 return 1;
@@ -171,9 +319,25 @@ int main(void)
 
         // Age apples and traps on grid
         age();
+
+        // Compact batch log: turn, move, head x, head y, size, score, moves
+        if (log)
+        {
+            printf("%li %c %i %i %i %i %i\n", turns, cursor, head->x, head->y, size, score, moves);
+        }
     }
 
-    printf("GAME OVER!\n");
+    if (!BATCH)
+    {
+        printf("GAME OVER!\n");
+    }
+
+    // Batch result
+    if (BATCH)
+    {
+        printf("turns %li size %i score %i moves %i end %s\n", turns, size, score, moves, end);
+    }
+    free(stream);
 
     // Recursively free the snake list
     lfree(tail);
@@ -394,7 +558,10 @@ void lead_node(node *n)
 // Crash statement protocols
 void crash(void)
 {
-    printf("Game over!!\n");
+    if (!BATCH)
+    {
+        printf("Game over!!\n");
+    }
 }
 
 // Check if head hits snake body
@@ -437,8 +604,8 @@ bool hit(node *head)
     }
 }
 
-// Upgarde snake list by appending node to the tail
-bool sizeup(node **tail)
+// Upgarde snake list by appending node to the tail on cell (x, y) it just left
+bool sizeup(node **tail, int x, int y)
 {
     node *t = *tail;
 
@@ -449,35 +616,13 @@ bool sizeup(node **tail)
         return false;
     }
 
-    // On grid, Place new node behind tail node
+    // On grid, Place new node on the cell the tail left, heading into the tail,
+    // behind the tail by its new direction lands on the body or off the grid at a bend
     n->prev = NULL;
-    if (t->axis)
-    {
-        if (t->direction)
-        {
-            n->y = t->y - 1;
-        }
-        else
-        {
-            n->y = t->y + 1;
-        }
-        n->x = t->x;
-    }
-    else
-    {
-        if (t->direction)
-        {
-            n->x = t->x - 1;
-        }
-        else
-        {
-            n->x = t->x + 1;
-        }
-        n->y = t->y;
-    }
-    // Inherit directions form tail node
-    n->axis = t->axis;
-    n->direction = t->direction;
+    n->x = x;
+    n->y = y;
+    n->axis = (t->x == x);
+    n->direction = (t->x > x || t->y > y);
 
     // Append new node to tail without orphaning
     n->prev = t;
@@ -514,10 +659,10 @@ void age(void)
 // Recharge moves based on apple age
 int recharge(int age)
 {
-    int moves = 21 - (age * 0.70);
-    if (moves < 8)
+    int moves = ECONOMY.apple_base - (age * ECONOMY.apple_decay);
+    if (moves < ECONOMY.apple_floor)
     {
-        return 8;
+        return ECONOMY.apple_floor;
     }
     else
     {
@@ -528,10 +673,10 @@ int recharge(int age)
 // Reward score based on apple age
 int reward(int age)
 {
-    int points = age * 0.5;
-    if (points > 10)
+    int points = age * ECONOMY.reward_rate;
+    if (points > ECONOMY.reward_cap)
     {
-         return 10;
+         return ECONOMY.reward_cap;
     }
     else
     {
@@ -550,4 +695,283 @@ void lfree(node *tail)
     lfree(tail->prev);
     free(tail);
     return;
-}
\ No newline at end of file
+}
+
+// Batch mode
+
+// Read the whole move stream into memory, NULL on error
+char *load_moves(const char *path, long *length)
+{
+    FILE *script = stdin;
+    if (strcmp(path, "-") != 0)
+    {
+        script = fopen(path, "rb");
+        if (script == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    // Grow the buffer by doubling until the stream is drained
+    long capacity = 4096;
+    char *stream = malloc(capacity);
+    *length = 0;
+    while (stream != NULL)
+    {
+        *length += fread(stream + *length, 1, capacity - *length, script);
+        if (*length < capacity)
+        {
+            break;
+        }
+        capacity *= 2;
+        char *grown = realloc(stream, capacity);
+        if (grown == NULL)
+        {
+            free(stream);
+        }
+        stream = grown;
+    }
+
+    if (script != stdin)
+    {
+        fclose(script);
+    }
+    return stream;
+}
+
+// Next move in the stream the prompt would accept, 0 when the stream runs out
+// Every letter is one move, whitespace and rejected letters are skipped
+char next_move(const char *stream, long length, long *at, char inertia)
+{
+    while (*at < length)
+    {
+        char cursor = toupper(stream[(*at)++]);
+        if ((cursor == 'R' || cursor == 'C' || cursor == 'F' || cursor == 'D') && cursor != inertia)
+        {
+            return cursor;
+        }
+    }
+    return 0;
+}
+
+// Autopilot
+
+// Copy the grid into the walled autopilot grid: snake and trap cells and the border are walls,
+// the tail cell is free since the tail moves on first, apples are goals
+void pilot_grid(node *tail)
+{
+    for (int c = 0; c < PILOT_CELLS; c++)
+    {
+        PILOT_WALL[c] = true;
+        PILOT_GOAL[c] = false;
+        PILOT_ORDER[c] = -1;
+    }
+    for (int y = 0; y < ROWS; y++)
+    {
+        for (int x = 0; x < COLUMNS; x++)
+        {
+            int c = (y + 1) * PILOT_WIDTH + x + 1;
+            PILOT_WALL[c] = GRID[y][x].snake || GRID[y][x].trap;
+            PILOT_GOAL[c] = GRID[y][x].apple;
+        }
+    }
+    // Segments in the order they move off
+    int order = 0;
+    for (node *ptr = tail; ptr != NULL; ptr = ptr->prev)
+    {
+        PILOT_BODY[order] = (ptr->y + 1) * PILOT_WIDTH + ptr->x + 1;
+        PILOT_ORDER[PILOT_BODY[order]] = order;
+        order++;
+    }
+    PILOT_LENGTH = order;
+    PILOT_WALL[(tail->y + 1) * PILOT_WIDTH + tail->x + 1] = false;
+    return;
+}
+
+// Start a new search, the visit stamps only need clearing when the counter wraps
+void next_stamp(void)
+{
+    PILOT_STAMP++;
+    if (PILOT_STAMP == 0)
+    {
+        memset(PILOT_SEEN, 0, sizeof(PILOT_SEEN));
+        memset(PILOT_TOUCHED, 0, sizeof(PILOT_TOUCHED));
+        PILOT_STAMP = 1;
+    }
+    return;
+}
+
+// Count the free cells reachable from start not visited since the last stamp,
+// stop counting at limit
+int flood(int start, int limit)
+{
+    int front = 0;
+    int back = 0;
+    PILOT_SEEN[start] = PILOT_STAMP;
+    PILOT_QUEUE[back++] = start;
+    while (front < back && back < limit)
+    {
+        int c = PILOT_QUEUE[front++];
+        for (int d = 0; d < PILOT_DIRECTIONS; d++)
+        {
+            int n = c + PILOT_STEP[d];
+            if (PILOT_WALL[n] || PILOT_SEEN[n] == PILOT_STAMP)
+            {
+                continue;
+            }
+            PILOT_SEEN[n] = PILOT_STAMP;
+            PILOT_QUEUE[back++] = n;
+        }
+    }
+    return back;
+}
+
+// Count the cells reachable from start like flood, and the body cells next to them once
+// the room can hold the head until they move off: segment i from the tail moves off after
+// i + 1 steps, so the tail cell is free from the start, and a room of n cells holds the
+// head for n / ROOM_HOLD steps. The search stamps the segments it runs into and walks
+// the body once from the tail, each segment it frees carrying the search on from its cell
+int escape(int start, int limit)
+{
+    int front = 0;
+    int back = 0;
+    int freed = 1;
+    PILOT_SEEN[start] = PILOT_STAMP;
+    PILOT_QUEUE[back++] = start;
+    while (back < limit)
+    {
+        while (front < back && back < limit)
+        {
+            int c = PILOT_QUEUE[front++];
+            for (int d = 0; d < PILOT_DIRECTIONS; d++)
+            {
+                int n = c + PILOT_STEP[d];
+                if (PILOT_SEEN[n] == PILOT_STAMP)
+                {
+                    continue;
+                }
+                if (PILOT_WALL[n] && (PILOT_ORDER[n] < 0 || PILOT_ORDER[n] >= freed))
+                {
+                    if (PILOT_ORDER[n] >= 0)
+                    {
+                        PILOT_TOUCHED[PILOT_ORDER[n]] = PILOT_STAMP;
+                    }
+                    continue;
+                }
+                PILOT_SEEN[n] = PILOT_STAMP;
+                PILOT_QUEUE[back++] = n;
+            }
+        }
+        // The segment next to the room that moves off first
+        int next = freed;
+        while (next < PILOT_LENGTH && PILOT_TOUCHED[next] != PILOT_STAMP)
+        {
+            next++;
+        }
+        if (back >= limit || next >= PILOT_LENGTH || next * ROOM_HOLD > back)
+        {
+            break;
+        }
+        freed = next + 1;
+        PILOT_SEEN[PILOT_BODY[next]] = PILOT_STAMP;
+        PILOT_QUEUE[back++] = PILOT_BODY[next];
+    }
+    return back;
+}
+
+// Autopilot move: breadth-first search to the nearest apple, taken when the snake still
+// fits in the room behind the first step once its body moves off, otherwise the step with
+// the most room
+char autopilot(node *head, node *tail, char inertia, int size)
+{
+    pilot_grid(tail);
+    next_stamp();
+    int front = 0;
+    int back = 0;
+    int start = (head->y + 1) * PILOT_WIDTH + head->x + 1;
+    PILOT_SEEN[start] = PILOT_STAMP;
+    for (int d = 0; d < PILOT_DIRECTIONS; d++)
+    {
+        int n = start + PILOT_STEP[d];
+        if (PILOT_KEYS[d] == inertia || PILOT_WALL[n])
+        {
+            continue;
+        }
+        PILOT_SEEN[n] = PILOT_STAMP;
+        PILOT_FIRST[n] = d;
+        PILOT_QUEUE[back++] = n;
+    }
+    int target = -1;
+    while (front < back)
+    {
+        int c = PILOT_QUEUE[front++];
+        if (PILOT_GOAL[c])
+        {
+            target = c;
+            break;
+        }
+        for (int d = 0; d < PILOT_DIRECTIONS; d++)
+        {
+            int n = c + PILOT_STEP[d];
+            if (PILOT_WALL[n] || PILOT_SEEN[n] == PILOT_STAMP)
+            {
+                continue;
+            }
+            PILOT_SEEN[n] = PILOT_STAMP;
+            PILOT_FIRST[n] = PILOT_FIRST[c];
+            PILOT_QUEUE[back++] = n;
+        }
+    }
+    if (target >= 0)
+    {
+        int d = PILOT_FIRST[target];
+        next_stamp();
+        PILOT_SEEN[start] = PILOT_STAMP;
+        if (escape(start + PILOT_STEP[d], size + 1) > size)
+        {
+            return PILOT_KEYS[d];
+        }
+    }
+
+    // No apple in reach or no room behind it, one stamp for every step so each
+    // region is counted once, a step into a counted region has no more room
+    int best = -1;
+    int room = 0;
+    next_stamp();
+    PILOT_SEEN[start] = PILOT_STAMP;
+    for (int d = 0; d < PILOT_DIRECTIONS; d++)
+    {
+        int n = start + PILOT_STEP[d];
+        if (PILOT_KEYS[d] == inertia || PILOT_WALL[n] || PILOT_SEEN[n] == PILOT_STAMP)
+        {
+            continue;
+        }
+        int r = flood(n, PILOT_CELLS);
+        if (r > room)
+        {
+            room = r;
+            best = d;
+        }
+    }
+    if (best >= 0)
+    {
+        return PILOT_KEYS[best];
+    }
+    // Boxed in, onto the segment beside the head that moves off first rather than into the
+    // border, any move the prompt accepts when the border is all there is
+    int nearest = -1;
+    for (int d = 0; d < PILOT_DIRECTIONS; d++)
+    {
+        int n = start + PILOT_STEP[d];
+        if (PILOT_KEYS[d] != inertia && PILOT_ORDER[n] >= 0
+            && (nearest < 0 || PILOT_ORDER[n] < PILOT_ORDER[start + PILOT_STEP[nearest]]))
+        {
+            nearest = d;
+        }
+    }
+    if (nearest >= 0)
+    {
+        return PILOT_KEYS[nearest];
+    }
+    return PILOT_KEYS[0] == inertia ? PILOT_KEYS[1] : PILOT_KEYS[0];
+}
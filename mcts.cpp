@@ -0,0 +1,151 @@
+// TREE SEARCH PLAYER: plays games with the search agent and compares them with the greedy bot
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <unistd.h>
+
+#include "mcts.h"
+
+using namespace std;
+
+// Constant: Ticks after which a searched game is called off
+const long SEARCH_TICK_LIMIT = 5000;
+
+// Data type: Results of the games played by one agent
+struct tally
+{
+    long games;
+    long ticks;
+    long score;
+    long length;
+    long deaths[DEATHS];
+};
+
+// Prototypes
+int play_game(const rules &r, uint64_t seed, bool searched, double ms, int threads, long limit, long *rollouts, tally *t);
+void report(const char *agent, const tally &t);
+
+int main(int argc, char *argv[])
+{
+    // Options: -v VARIANT picks the rules, -n GAMES to play, -s SEED numbers the games from SEED,
+    // -m MS searched per move (the live variants tick every 300 ms or less), -t THREADS growing trees,
+    // -k TICKS calls a game off
+    const rules *r = &RULES[ECO];
+    long games = 4;
+    uint64_t seed = 1;
+    double ms = 20;
+    int threads = thread::hardware_concurrency();
+    long limit = SEARCH_TICK_LIMIT;
+    int opt;
+    while ((opt = getopt(argc, argv, "v:n:s:m:t:k:")) != -1)
+    {
+        if (opt == 'v')
+        {
+            r = find_rules(optarg);
+            if (r == NULL)
+            {
+                cerr << "Unknown variant " << optarg << "\n";
+                return 1;
+            }
+        }
+        else if (opt == 'n')
+        {
+            games = atol(optarg);
+        }
+        else if (opt == 's')
+        {
+            seed = strtoull(optarg, NULL, 10);
+        }
+        else if (opt == 'm')
+        {
+            ms = atof(optarg);
+        }
+        else if (opt == 't')
+        {
+            threads = atoi(optarg);
+        }
+        else if (opt == 'k')
+        {
+            limit = atol(optarg);
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-v VARIANT] [-n GAMES] [-s SEED] [-m MS] [-t THREADS] [-k TICKS]\n";
+            return 1;
+        }
+    }
+    threads = max(threads, 1);
+    if (!board_fits(*r))
+    {
+        cerr << "Variant " << r->name << " does not fit the bitboard engine\n";
+        return 1;
+    }
+
+    tally greedy = {};
+    tally searched = {};
+    long rollouts = 0;
+    double seconds = 0;
+    for (long g = 0; g < games; g++)
+    {
+        play_game(*r, seed + g, false, 0, 1, limit, NULL, &greedy);
+        auto start = chrono::steady_clock::now();
+        long ticks = searched.ticks;
+        int death = play_game(*r, seed + g, true, ms, threads, limit, &rollouts, &searched);
+        seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "GAME " << seed + g << " ticks " << searched.ticks - ticks << " end "
+             << (death == NONE ? "tick limit" : DEATH_NAMES[death]) << "\n";
+    }
+
+    cout << "SEARCH " << r->name << " games " << games << " threads " << threads << " ms/move " << ms << "\n";
+    report("greedy", greedy);
+    report("search", searched);
+    cout << fixed << setprecision(0) << "ROLLOUTS total " << rollouts << " per move "
+         << (searched.ticks > 0 ? (double) rollouts / searched.ticks : 0)
+         << " per second " << (seconds > 0 ? rollouts / seconds : 0) << "\n";
+    return 0;
+}
+
+// Play game seed to its end with the greedy bot or the search agent, returns how it ended
+int play_game(const rules &r, uint64_t seed, bool searched, double ms, int threads, long limit, long *rollouts, tally *t)
+{
+    board b = {};
+    setup_board(&b, r, seed);
+    uint64_t search_seed = seed ^ 0x5EA2C4ULL;
+    int death = NONE;
+    while (death == NONE && b.ticks < limit)
+    {
+        int action;
+        if (searched)
+        {
+            action = search_action(b, r, ms, 0, threads, next_random(&search_seed), rollouts);
+        }
+        else
+        {
+            action = greedy_board(b, r);
+        }
+        death = step_board(&b, r, action, NULL);
+    }
+    t->games++;
+    t->ticks += b.ticks;
+    t->score += b.score;
+    t->length += b.length;
+    t->deaths[death]++;
+    return death;
+}
+
+// Print the averages and deaths of one agent
+void report(const char *agent, const tally &t)
+{
+    double n = t.games > 0 ? t.games : 1;
+    cout << left << setw(8) << agent << right << fixed << setprecision(1)
+         << " score " << setw(8) << t.score / n
+         << " size " << setw(7) << t.length / n
+         << " ticks " << setw(8) << t.ticks / n;
+    for (int d = 1; d < DEATHS; d++)
+    {
+        cout << " " << DEATH_NAMES[d] << " " << t.deaths[d];
+    }
+    cout << " limit " << t.deaths[NONE] << "\n";
+    return;
+}
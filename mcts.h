@@ -0,0 +1,311 @@
+// TREE SEARCH AGENT: root parallel Monte Carlo tree search on bitboard clones
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "bot.h"
+
+using namespace std;
+
+// Constant: Ticks a rollout plays on past the tree
+const int ROLLOUT_TICKS = 40;
+
+// Constant: Deepest path through the tree
+const int SEARCH_DEPTH = 64;
+
+// Constant: Chance a rollout step asks the greedy bot instead of a random safe direction
+const double ROLLOUT_GREEDY = 0.75;
+
+// Constant: Score a death costs, and what a move left is worth at the end of a rollout
+// up to MOVES_WORTH_CAP moves. Rollouts end long before the moves run out, cheaper moves
+// let the search age apples for points until the snake starves
+const double DEATH_COST = 100;
+const double MOVE_WORTH = 2.0;
+const int MOVES_WORTH_CAP = 100;
+
+// Constant: Exploration weight of UCT on values scaled to 0 .. 1
+const double EXPLORE = 1.0;
+
+// Constant: Iterations between two looks at the clock
+const int CLOCK_EVERY = 16;
+
+// Data type: Node of a search tree, its children sit next to each other
+struct search_node
+{
+    // First child, -1 until expanded
+    int32_t first;
+    int8_t children;
+    // Action that leads here from the parent
+    int8_t action;
+    int32_t visits;
+    double total;
+};
+
+// Data type: Tree grown by one thread from its own clone of the root
+struct search_tree
+{
+    vector<search_node> nodes;
+    uint64_t seed;
+    // Lowest and highest rollout values seen, to scale the node values
+    double low;
+    double high;
+    long rollouts;
+};
+
+// Action can be taken without crashing on the spot: a direction that is not a reversal
+// into a free cell (the tail cell frees up first), or a teleport through an open portal
+inline bool open_action(const board &b, const rules &r, int action)
+{
+    if (action == TELEPORT)
+    {
+        return r.portal && b.portal_time > 0 && b.jump_count < JUMPS;
+    }
+    if (action == OPPOSITE[b.direction])
+    {
+        return false;
+    }
+    int x = b.head % BOARD_COLUMNS + DX[action];
+    int y = b.head / BOARD_COLUMNS + DY[action];
+    if (x < 0 || x >= BOARD_COLUMNS || y < 0 || y >= BOARD_ROWS)
+    {
+        return false;
+    }
+    int cell = y * BOARD_COLUMNS + x;
+    return !test_bit(b.trap, cell) && (!test_bit(b.body, cell) || cell == b.tail);
+}
+
+// Give node n a child for every open action, or every direction when none is open
+inline void expand(search_tree *t, int n, const board &b, const rules &r)
+{
+    int8_t actions[ACTIONS];
+    int count = 0;
+    for (int a = 0; a < r.directions; a++)
+    {
+        if (open_action(b, r, a))
+        {
+            actions[count++] = a;
+        }
+    }
+    if (open_action(b, r, TELEPORT))
+    {
+        actions[count++] = TELEPORT;
+    }
+    if (count == 0)
+    {
+        actions[count++] = b.direction;
+    }
+
+    int first = t->nodes.size();
+    for (int i = 0; i < count; i++)
+    {
+        t->nodes.push_back({-1, 0, actions[i], 0, 0});
+    }
+    t->nodes[n].first = first;
+    t->nodes[n].children = count;
+    return;
+}
+
+// UCT child of node n, unvisited children first
+inline int pick(const search_tree &t, int n)
+{
+    const search_node &parent = t.nodes[n];
+    double scale = t.high > t.low ? 1.0 / (t.high - t.low) : 0;
+    double log_visits = log((double) parent.visits + 1);
+    int best = parent.first;
+    double best_score = -1;
+    for (int c = parent.first; c < parent.first + parent.children; c++)
+    {
+        const search_node &child = t.nodes[c];
+        if (child.visits == 0)
+        {
+            return c;
+        }
+        double value = (child.total / child.visits - t.low) * scale;
+        double score = value + EXPLORE * sqrt(log_visits / child.visits);
+        if (score > best_score)
+        {
+            best_score = score;
+            best = c;
+        }
+    }
+    return best;
+}
+
+// Rollout step: mostly the greedy bot, otherwise a random open direction
+inline int rollout_action(const board &b, const rules &r, uint64_t *seed)
+{
+    if ((next_random(seed) >> 11) * 0x1.0p-53 < ROLLOUT_GREEDY)
+    {
+        return greedy_board(b, r);
+    }
+    int open[8];
+    int count = 0;
+    for (int d = 0; d < r.directions; d++)
+    {
+        if (open_action(b, r, d))
+        {
+            open[count++] = d;
+        }
+    }
+    return count > 0 ? open[random_below(seed, count)] : b.direction;
+}
+
+// Play a rollout from b, whose last step ended as death, and value the result against
+// the score at the root
+inline double rollout(board *b, const rules &r, int death, int score, uint64_t *seed)
+{
+    for (int i = 0; i < ROLLOUT_TICKS && death == NONE; i++)
+    {
+        death = step_board(b, r, rollout_action(*b, r, seed), NULL);
+    }
+    double value = b->score - score;
+    if (death != NONE)
+    {
+        value -= DEATH_COST;
+    }
+    else if (r.moves > 0)
+    {
+        value += MOVE_WORTH * min(b->moves, MOVES_WORTH_CAP);
+    }
+    return value;
+}
+
+// One iteration: select down the tree on a clone of the root, expand a leaf, roll out
+// and back up. The clone gets a fresh random stream, so spawns past the root are
+// sampled instead of read from the game's own future
+inline void grow(search_tree *t, const board &root, const rules &r)
+{
+    board b;
+    clone_board(&b, root);
+    b.seed = next_random(&t->seed);
+
+    int path[SEARCH_DEPTH + 1];
+    int depth = 0;
+    int n = 0;
+    path[depth++] = n;
+    int death = NONE;
+    while (death == NONE && depth <= SEARCH_DEPTH)
+    {
+        if (t->nodes[n].first < 0)
+        {
+            // Leaves are expanded on their second visit
+            if (n != 0 && t->nodes[n].visits == 0)
+            {
+                break;
+            }
+            expand(t, n, b, r);
+        }
+        n = pick(*t, n);
+        path[depth++] = n;
+        death = step_board(&b, r, t->nodes[n].action, NULL);
+        if (t->nodes[n].visits == 0)
+        {
+            break;
+        }
+    }
+
+    double value = rollout(&b, r, death, root.score, &t->seed);
+    t->low = min(t->low, value);
+    t->high = max(t->high, value);
+    for (int i = 0; i < depth; i++)
+    {
+        t->nodes[path[i]].visits++;
+        t->nodes[path[i]].total += value;
+    }
+    t->rollouts++;
+    return;
+}
+
+// Grow a tree until the deadline, or by a fixed count of iterations when count > 0 so the
+// tree does not depend on the speed of the machine
+inline void grow_until(search_tree *t, const board &root, const rules &r, chrono::steady_clock::time_point deadline, long count)
+{
+    if (count > 0)
+    {
+        for (long i = 0; i < count; i++)
+        {
+            grow(t, root, r);
+        }
+        return;
+    }
+    do
+    {
+        for (int i = 0; i < CLOCK_EVERY; i++)
+        {
+            grow(t, root, r);
+        }
+    }
+    while (chrono::steady_clock::now() < deadline);
+    return;
+}
+
+// Tree i's share of count iterations split over threads trees, at least one when count > 0
+inline long share(long count, int threads, int i)
+{
+    if (count <= 0)
+    {
+        return 0;
+    }
+    return max(count / threads + (i < count % threads ? 1 : 0), 1L);
+}
+
+// Action for board b after searching for ms milliseconds on threads independent trees, or
+// for iterations rollouts split over the trees when iterations > 0, the root children of
+// every tree are expanded the same way so their visits add up. Adds the rollouts played
+// to *rollouts
+inline int search_action(const board &b, const rules &r, double ms, long iterations, int threads, uint64_t seed,
+                         long *rollouts)
+{
+    auto deadline = chrono::steady_clock::now() + chrono::microseconds((long) (ms * 1000));
+    vector<search_tree> trees(threads);
+    for (int i = 0; i < threads; i++)
+    {
+        trees[i].nodes.reserve(1 << 16);
+        trees[i].nodes.push_back({-1, 0, -1, 0, 0});
+        trees[i].seed = seed + i * 0x9E3779B97F4A7C15ULL;
+        trees[i].low = 0;
+        trees[i].high = 0;
+        trees[i].rollouts = 0;
+    }
+
+    // The calling thread grows the first tree
+    vector<thread> pool;
+    for (int i = 1; i < threads; i++)
+    {
+        pool.emplace_back(grow_until, &trees[i], cref(b), cref(r), deadline, share(iterations, threads, i));
+    }
+    grow_until(&trees[0], b, r, deadline, share(iterations, threads, 0));
+    for (thread &t : pool)
+    {
+        t.join();
+    }
+
+    const search_node &root = trees[0].nodes[0];
+    int best = root.first;
+    long best_visits = -1;
+    for (int c = 0; c < root.children; c++)
+    {
+        long visits = 0;
+        for (int i = 0; i < threads; i++)
+        {
+            visits += trees[i].nodes[trees[i].nodes[0].first + c].visits;
+        }
+        if (visits > best_visits)
+        {
+            best_visits = visits;
+            best = root.first + c;
+        }
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        *rollouts += trees[i].rollouts;
+    }
+    return trees[0].nodes[best].action;
+}
+
+#endif
@@ -0,0 +1,269 @@
+// THREAD POOL: plays bot games on every core and adds up the results
+#ifndef POOL_H
+#define POOL_H
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "agents.h"
+#include "batch.h"
+#include "board.h"
+#include "bot.h"
+
+using namespace std;
+
+// Data type: Game numbers a worker has left, its owner takes chunks from the front
+// and idle workers steal the back half
+struct worker
+{
+    mutex lock;
+    long next;
+    long end;
+};
+
+// Data type: Results of one thread, on cache lines of its own
+struct alignas(64) stats
+{
+    long games;
+    long ticks;
+    // Histograms of final size, score and moves left
+    vector<long> size;
+    vector<long> score;
+    vector<long> moves;
+    long deaths[DEATHS];
+};
+
+// Constant: Games stepped together by a worker
+const long CHUNK = 64;
+
+// Constant: Ticks after which a game is called off
+const long TICK_LIMIT = 100000;
+
+// Take the next chunk of games for worker self, stealing when its own range is empty
+inline bool take(vector<worker> &workers, int self, long chunk, long *begin, long *end)
+{
+    worker &own = workers[self];
+    {
+        lock_guard<mutex> hold(own.lock);
+        if (own.next < own.end)
+        {
+            *begin = own.next;
+            *end = min(own.next + chunk, own.end);
+            own.next = *end;
+            return true;
+        }
+    }
+
+    // Steal the back half of the next worker with games left
+    int count = workers.size();
+    for (int i = 1; i < count; i++)
+    {
+        worker &victim = workers[(self + i) % count];
+        long low, high;
+        {
+            lock_guard<mutex> hold(victim.lock);
+            long left = victim.end - victim.next;
+            if (left <= 0)
+            {
+                continue;
+            }
+            high = victim.end;
+            low = high - (left + 1) / 2;
+            victim.end = low;
+        }
+        lock_guard<mutex> hold(own.lock);
+        *begin = low;
+        *end = min(low + chunk, high);
+        own.next = *end;
+        own.end = high;
+        return true;
+    }
+    return false;
+}
+
+// Count one value in a histogram that grows as needed
+inline void count(vector<long> *histogram, int value)
+{
+    if ((int) histogram->size() <= value)
+    {
+        histogram->resize(value + 1, 0);
+    }
+    (*histogram)[value]++;
+    return;
+}
+
+// Play games begin to end side by side, game n draws from its own stream seeded seed + n
+// so results do not depend on the thread count
+inline void play(batch *b, const rules &r, uint64_t seed, long begin, long end, stats *s)
+{
+    int n = end - begin;
+    setup_batch(b, r, n, seed + begin, false);
+    vector<int32_t> actions(n);
+
+    int left = n;
+    while (left > 0)
+    {
+        greedy_actions(*b, actions.data());
+        step_batch(b, actions.data());
+        for (int g = 0; g < n; g++)
+        {
+            // Call off endless games
+            if (!b->done[g] && !b->over[g] && b->ticks[g] >= TICK_LIMIT)
+            {
+                end_game(b, g, NONE);
+            }
+            if (b->done[g])
+            {
+                s->games++;
+                s->ticks += b->final_ticks[g];
+                count(&s->size, b->final_length[g]);
+                count(&s->score, b->final_score[g]);
+                count(&s->moves, max(b->final_moves[g], 0));
+                s->deaths[b->death[g]]++;
+                left--;
+            }
+        }
+    }
+    return;
+}
+
+// Play games begin to end one at a time on the bitboard engine, same games as play,
+// with the agent bot when set and the greedy bot otherwise
+inline void play_boards(const rules &r, uint64_t seed, long begin, long end, const agent *bot, const budget_table *plan,
+                        stats *s)
+{
+    board b;
+    agent_state state;
+    for (long n = begin; n < end; n++)
+    {
+        setup_board(&b, r, seed + n);
+        state = {&r, plan, (seed + n) ^ 0x5EA2C4ULL, 0, 0, SCRIPT, {}, {}};
+        int death = NONE;
+        while (death == NONE && b.ticks < TICK_LIMIT)
+        {
+            int action = bot != NULL ? bot->move(b, &state) : greedy_board(b, r);
+            death = step_board(&b, r, action, NULL);
+        }
+        s->games++;
+        s->ticks += b.ticks;
+        count(&s->size, b.length);
+        count(&s->score, b.score);
+        count(&s->moves, max(b.moves, 0));
+        s->deaths[death]++;
+    }
+    return;
+}
+
+// Worker thread: play chunks until no worker has games left
+inline void work(vector<worker> &workers, int self, const rules &r, uint64_t seed, long chunk, bool bitboards,
+                 const agent *bot, const budget_table *plan, stats *s)
+{
+    batch b;
+    long begin, end;
+    while (take(workers, self, chunk, &begin, &end))
+    {
+        if (bitboards)
+        {
+            play_boards(r, seed, begin, end, bot, plan, s);
+        }
+        else
+        {
+            play(&b, r, seed, begin, end, s);
+        }
+    }
+    return;
+}
+
+// Add the results of a thread to the total
+inline void merge(stats *total, const stats &s)
+{
+    total->games += s.games;
+    total->ticks += s.ticks;
+    const vector<long> *from[] = {&s.size, &s.score, &s.moves};
+    vector<long> *to[] = {&total->size, &total->score, &total->moves};
+    for (int i = 0; i < 3; i++)
+    {
+        if (to[i]->size() < from[i]->size())
+        {
+            to[i]->resize(from[i]->size(), 0);
+        }
+        for (size_t v = 0; v < from[i]->size(); v++)
+        {
+            (*to[i])[v] += (*from[i])[v];
+        }
+    }
+    for (int d = 0; d < DEATHS; d++)
+    {
+        total->deaths[d] += s.deaths[d];
+    }
+    return;
+}
+
+// Smallest value with at least p of the counts at or below it
+inline long quantile(const vector<long> &histogram, long total, double p)
+{
+    long seen = 0;
+    for (size_t v = 0; v < histogram.size(); v++)
+    {
+        seen += histogram[v];
+        if (seen >= p * total)
+        {
+            return v;
+        }
+    }
+    return histogram.empty() ? 0 : histogram.size() - 1;
+}
+
+// Average value of a histogram
+inline double mean(const vector<long> &histogram, long total)
+{
+    double sum = 0;
+    for (size_t v = 0; v < histogram.size(); v++)
+    {
+        sum += (double) v * histogram[v];
+    }
+    return total > 0 ? sum / total : 0;
+}
+
+// Play games seed to seed + games - 1 on threads workers and add up their results,
+// on the bitboard engine when asked and the rules fit it. An agent plays on the bitboard
+// engine, the budget planner's prices are worked out once for every thread
+inline void simulate(const rules &r, uint64_t seed, long games, int threads, long chunk, bool bitboards,
+                     const agent *bot, stats *total)
+{
+    bitboards = (bitboards || bot != NULL) && board_fits(r);
+    bot = bitboards ? bot : NULL;
+    budget_table table = {};
+    if (bot != NULL && bot->move == budget_agent)
+    {
+        table = make_budget(r);
+    }
+
+    // Deal the games out evenly, stealing evens out the rest
+    vector<worker> workers(threads);
+    for (int t = 0; t < threads; t++)
+    {
+        workers[t].next = games * t / threads;
+        workers[t].end = games * (t + 1) / threads;
+    }
+    vector<stats> results(threads);
+
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++)
+    {
+        pool.emplace_back(work, ref(workers), t, cref(r), seed, chunk, bitboards, bot, &table, &results[t]);
+    }
+    for (thread &t : pool)
+    {
+        t.join();
+    }
+    for (const stats &s : results)
+    {
+        merge(total, s);
+    }
+    return;
+}
+
+#endif
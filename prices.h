@@ -0,0 +1,80 @@
+// ECONOMY PRICES shared by the interactive programs and the simulation tools, plain C so
+// the C variants read the same prices as the C++ ones
+#ifndef PRICES_H
+#define PRICES_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Data type: Prices of the moves economy
+typedef struct price_list
+{
+    // Apples recharge base - age * decay moves, at least floor
+    double apple_base;
+    double apple_decay;
+    double apple_floor;
+    // Bananas recharge the same way with their own prices
+    double banana_base;
+    double banana_decay;
+    double banana_floor;
+    // Apples reward age * rate points, at most cap
+    double reward_rate;
+    double reward_cap;
+} price_list;
+
+// Constant: Prices of the interactive programs
+static const price_list PRICES = {21, 0.70, 8, 30, 0.70, 12, 0.5, 10};
+
+// Constant: Trap life and starting moves of the interactive programs
+#define PRICE_TRAP_LIFE 125
+#define PRICE_MOVES 50
+
+// Constant: Parameter names of the sweep CSV and of the programs' -P flag, the prices in
+// price_list order, then trap life and starting moves
+static const char *const PRICE_PARAMS[] = {"apple_base", "apple_decay", "apple_floor",
+                                           "banana_base", "banana_decay", "banana_floor",
+                                           "reward_rate", "reward_cap", "trap_life", "moves"};
+#define PRICE_PARAM_COUNT 10
+
+// Set one parameter from NAME=VALUE, false when the name is unknown or the value is not a
+// number, negative, or not a whole number of at least 1 for trap life and starting moves
+static inline bool set_price(price_list *p, int *trap_life, int *moves, const char *spec)
+{
+    const char *equals = strchr(spec, '=');
+    if (equals == NULL || equals[1] == '\0')
+    {
+        return false;
+    }
+    int param = -1;
+    for (int i = 0; i < PRICE_PARAM_COUNT; i++)
+    {
+        size_t length = strlen(PRICE_PARAMS[i]);
+        if (length == (size_t) (equals - spec) && strncmp(spec, PRICE_PARAMS[i], length) == 0)
+        {
+            param = i;
+        }
+    }
+    char *end;
+    double value = strtod(equals + 1, &end);
+    if (param < 0 || *end != '\0' || value < 0)
+    {
+        return false;
+    }
+    double *prices[] = {&p->apple_base, &p->apple_decay, &p->apple_floor,
+                        &p->banana_base, &p->banana_decay, &p->banana_floor,
+                        &p->reward_rate, &p->reward_cap};
+    if (param < 8)
+    {
+        *prices[param] = value;
+        return true;
+    }
+    if (value < 1 || value > 1000000 || value != (int) value)
+    {
+        return false;
+    }
+    *(param == 8 ? trap_life : moves) = (int) value;
+    return true;
+}
+
+#endif
@@ -0,0 +1,171 @@
+// HEADLESS RULES shared by the simulation tools
+#ifndef RULES_H
+#define RULES_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "prices.h"
+
+// Data type: Rule set of one game variant, mirrors the interactive programs
+struct rules
+{
+    const char *name;
+    // Grid dimensions
+    int rows;
+    int columns;
+    // 4: W S D A | 8: adds the diagonals U J K I
+    int directions;
+    // Diagonal steps cost one extra move
+    bool diagonal_cost;
+    // A trap spawns with every new apple
+    bool traps;
+    // Trap life span in ticks, 0 keeps traps forever
+    int trap_life;
+    // Starting moves, 0 for unlimited moves
+    int moves;
+    // Apples recharge moves and reward by age instead of scoring 1 each
+    bool economy;
+    // Apples and bananas on the grid at the start, with bananas on the grid
+    // bananas recharge moves and apples only reward
+    int apples;
+    int bananas;
+    // Teleport portal opens every teleport_reset ticks for teleport_time ticks
+    bool portal;
+    int teleport_reset;
+    int teleport_time;
+    // Recharge and reward prices
+    price_list prices;
+};
+
+// Variant ids, in the order of RULES
+enum variant
+{
+    ENGINE,
+    SNAKE,
+    PLUS,
+    ECO,
+    FUEL,
+    LIVE,
+    ALIVE,
+    FRUIT,
+    TELE,
+    VARIANTS
+};
+
+// Constant: Rule set of every variant
+// Starting items count the ones spawned before the loop plus the first ate turn,
+// headless games start heading right instead of standing still
+const rules RULES[VARIANTS] =
+{
+    // name     rows cols dirs  diag   traps  life moves economy apples bananas portal reset time prices
+    {"engine",  15, 25, 4, false, false, 0,   0,  false, 1, 0, false, 0,  0, PRICES},
+    {"snake",   15, 25, 4, false, false, 0,   0,  false, 1, 0, false, 0,  0, PRICES},
+    {"plus",    15, 25, 4, false, true,  0,   0,  false, 1, 0, false, 0,  0, PRICES},
+    {"eco",     15, 25, 4, false, true,  125, 50, true,  2, 0, false, 0,  0, PRICES},
+    {"fuel",    15, 25, 4, false, true,  125, 50, true,  2, 0, false, 0,  0, PRICES},
+    {"live",    15, 25, 4, false, true,  125, 50, true,  2, 0, false, 0,  0, PRICES},
+    {"alive",   15, 25, 8, true,  true,  125, 50, true,  3, 0, false, 0,  0, PRICES},
+    {"fruit",   15, 25, 8, true,  true,  125, 50, true,  2, 2, false, 0,  0, PRICES},
+    {"tele",    15, 25, 8, true,  true,  125, 50, true,  3, 0, true,  20, 3, PRICES},
+};
+
+// Actions: directions in key order W S D A U J K I, then teleport (T)
+const char KEYS[] = "WSDAUJKIT";
+const int TELEPORT = 8;
+const int ACTIONS = 9;
+
+// Constant: Step of every direction and the direction opposite to it
+const int DX[8] = {0, 0, 1, -1, -1, -1, 1, 1};
+const int DY[8] = {-1, 1, 0, 0, -1, 1, 1, -1};
+const int OPPOSITE[8] = {1, 0, 3, 2, 6, 7, 4, 5};
+
+// How a game ended
+enum death
+{
+    NONE,
+    BOUNDARY,
+    SELF,
+    TRAP,
+    MOVES,
+    DEATHS
+};
+
+// Constant: Death names for reports
+const char *const DEATH_NAMES[DEATHS] = {"none", "boundary", "self", "trap", "moves"};
+
+// Look up a variant's rules by name, NULL if unknown
+inline const rules *find_rules(const char *name)
+{
+    for (int v = 0; v < VARIANTS; v++)
+    {
+        if (strcmp(RULES[v].name, name) == 0)
+        {
+            return &RULES[v];
+        }
+    }
+    return NULL;
+}
+
+// Random numbers: splitmix64, one 64-bit state per game so games replay from a seed
+
+// Next 64 random bits
+inline uint64_t next_random(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Random integer in [0, n)
+inline int random_below(uint64_t *state, int n)
+{
+    return (int) (((next_random(state) >> 32) * (uint64_t) n) >> 32);
+}
+
+// Economic Algorithms
+
+// Recharge moves based on apple age
+inline int recharge(const price_list &p, int age)
+{
+    int moves = p.apple_base - (age * p.apple_decay);
+    if (moves < p.apple_floor)
+    {
+        return p.apple_floor;
+    }
+    else
+    {
+        return moves;
+    }
+}
+
+// Recharge moves based on banana age
+inline int recharge_banana(const price_list &p, int age)
+{
+    int moves = p.banana_base - (age * p.banana_decay);
+    if (moves < p.banana_floor)
+    {
+        return p.banana_floor;
+    }
+    else
+    {
+        return moves;
+    }
+}
+
+// Reward score based on apple age
+inline int reward(const price_list &p, int age)
+{
+    int points = age * p.reward_rate;
+    if (points > p.reward_cap)
+    {
+        return p.reward_cap;
+    }
+    else
+    {
+        return points;
+    }
+}
+
+#endif
@@ -0,0 +1,108 @@
+// SAFETY CHECKS: room the head finds behind each step with the body moving off its cells,
+// flooded a whole frontier per round on the occupancy planes
+#ifndef SAFETY_H
+#define SAFETY_H
+
+#include "board.h"
+
+// Constant: Steps a room holds the head per cell, the head winding through it fills it
+// with its own body well before every cell is used
+const int ROOM_HOLD = 4;
+
+// Body cells from the tail to the head, returns how many
+inline int body_cells(const board &b, int16_t *cells)
+{
+    int jumps = 0;
+    int cell = b.tail;
+    int n = 0;
+    while (n < CELLS)
+    {
+        cells[n++] = cell;
+        if (cell == b.head)
+        {
+            break;
+        }
+        int link = get_link(b, cell);
+        if (link == JUMP)
+        {
+            cell = b.jumps[(b.jump_first + jumps++) % JUMPS];
+        }
+        else
+        {
+            cell += DY[link] * BOARD_COLUMNS + DX[link];
+        }
+    }
+    return n;
+}
+
+// Cells the head can reach after stepping onto cell. Segment i of the body (count of them,
+// tail first) moves off after i + 1 steps, so the tail cell is open from the start and a
+// segment beside the room opens once the room can hold the head that long: a room of n
+// cells lasts n / ROOM_HOLD steps. Traps stay and apples eaten on the way are not counted
+// against the tail. Stops counting at enough
+inline int room_ahead(const board &b, int dirs, int cell, const int16_t *body, int count, int enough)
+{
+    bitboard open = without(MASKS.grid, b.body | b.trap);
+    set_bit(&open, body[0]);
+    int freed = 1;
+    bitboard from = {};
+    set_bit(&from, cell);
+    bitboard seen = reach(from, open, dirs);
+    while (true)
+    {
+        int room = count_bits(seen);
+        if (room >= enough)
+        {
+            return room;
+        }
+        // The segment beside the room that moves off first
+        bitboard beside = without(neighbours(seen, dirs) & b.body, open);
+        int next = freed;
+        while (next < count && !test_bit(beside, body[next]))
+        {
+            next++;
+        }
+        if (next >= count || next * ROOM_HOLD > room)
+        {
+            return room;
+        }
+        for (; freed <= next; freed++)
+        {
+            set_bit(&open, body[freed]);
+        }
+        seen = reach(seen, open, dirs);
+    }
+}
+
+// Room behind each of the first r.directions steps, -1 for the reversal and for steps that
+// crash on the spot, counting stops at enough
+inline void rooms_ahead(const board &b, const rules &r, int enough, int *rooms)
+{
+    int16_t body[CELLS];
+    int count = body_cells(b, body);
+    for (int d = 0; d < r.directions; d++)
+    {
+        rooms[d] = -1;
+        int x = b.head % BOARD_COLUMNS + DX[d];
+        int y = b.head / BOARD_COLUMNS + DY[d];
+        if (d == OPPOSITE[b.direction] || x < 0 || x >= BOARD_COLUMNS || y < 0 || y >= BOARD_ROWS)
+        {
+            continue;
+        }
+        int cell = y * BOARD_COLUMNS + x;
+        if (test_bit(b.trap, cell) || (test_bit(b.body, cell) && cell != b.tail))
+        {
+            continue;
+        }
+        rooms[d] = room_ahead(b, r.directions, cell, body, count, enough);
+    }
+    return;
+}
+
+// A step traps the snake: it does not crash but the room behind it cannot hold the body
+inline bool trapped(const board &b, const int *rooms, int d)
+{
+    return rooms[d] >= 0 && rooms[d] < b.length;
+}
+
+#endif
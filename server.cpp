@@ -0,0 +1,258 @@
+// ENVIRONMENT SERVER: batches of headless games stepped through POSIX shared memory
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "batch.h"
+#include "encode.h"
+#include "shm.h"
+
+using namespace std;
+
+// Constant: Milliseconds a futex wait sleeps before checking for shutdown
+const long WAIT_MS = 100;
+
+// Global variable: Set by SIGINT / SIGTERM to stop serving
+volatile sig_atomic_t STOP = 0;
+
+// Prototypes
+void request_stop(int sig);
+int serve(const char *name, const rules &r, int variant, uint32_t games, uint32_t slots, uint64_t seed, const encoding &e);
+void publish(shm_header *h, const batch &b, const encoding &e, uint32_t n);
+int bench(const char *name, long steps, bool quit);
+
+int main(int argc, char *argv[])
+{
+    // Options: -m NAME of the shared memory region, -v VARIANT picks the rules,
+    // -n GAMES in the batch, -k SLOTS in the ring, -s SEED numbers the games from SEED,
+    // -e u8|f32 also writes observation tensors into the slots, -l chw|hwc lays them out,
+    // -b STEPS attaches to a running server and steps it with random actions, -q then stops it
+    const char *name = "/snake";
+    int variant = ECO;
+    uint32_t games = 1024;
+    uint32_t slots = 2;
+    uint64_t seed = 1;
+    long steps = 0;
+    bool quit = false;
+    int type = NO_TENSOR;
+    int layout = CHW;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:v:n:k:s:e:l:b:q")) != -1)
+    {
+        if (opt == 'm')
+        {
+            name = optarg;
+        }
+        else if (opt == 'v')
+        {
+            const rules *r = find_rules(optarg);
+            if (r == NULL)
+            {
+                cerr << "Unknown variant " << optarg << "\n";
+                return 1;
+            }
+            variant = r - RULES;
+        }
+        else if (opt == 'n')
+        {
+            games = strtoul(optarg, NULL, 10);
+        }
+        else if (opt == 'k')
+        {
+            slots = strtoul(optarg, NULL, 10);
+        }
+        else if (opt == 's')
+        {
+            seed = strtoull(optarg, NULL, 10);
+        }
+        else if (opt == 'e' && (strcmp(optarg, "u8") == 0 || strcmp(optarg, "f32") == 0))
+        {
+            type = strcmp(optarg, "u8") == 0 ? TENSOR_U8 : TENSOR_F32;
+        }
+        else if (opt == 'l' && (strcmp(optarg, "chw") == 0 || strcmp(optarg, "hwc") == 0))
+        {
+            layout = strcmp(optarg, "chw") == 0 ? CHW : HWC;
+        }
+        else if (opt == 'b')
+        {
+            steps = atol(optarg);
+        }
+        else if (opt == 'q')
+        {
+            quit = true;
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-m NAME] [-v VARIANT] [-n GAMES] [-k SLOTS] [-s SEED] [-e u8|f32] [-l chw|hwc] | [-m NAME] -b STEPS [-q]\n";
+            return 1;
+        }
+    }
+    if (steps > 0 || quit)
+    {
+        return bench(name, steps, quit);
+    }
+    if (games == 0 || slots < 2)
+    {
+        cerr << "Need at least one game and two slots\n";
+        return 1;
+    }
+    encoding e = make_encoding(RULES[variant], type, layout);
+    return serve(name, RULES[variant], variant, games, slots, seed, e);
+}
+
+// Stop serving at the next wake up
+void request_stop(int sig)
+{
+    (void) sig;
+    STOP = 1;
+    return;
+}
+
+// Create the region, then step the batch every time a trainer asks until stopped
+int serve(const char *name, const rules &r, int variant, uint32_t games, uint32_t slots, uint64_t seed, const encoding &e)
+{
+    shm_header layout;
+    uint64_t tensor = (e.type == NO_TENSOR) ? 0 : tensor_bytes(e, r.rows * r.columns);
+    layout_shm(&layout, games, r.rows, r.columns, slots, variant, e.type, e.layout, tensor);
+    uint64_t bytes = shm_bytes(&layout);
+
+    // Never take over a region another server still owns, a stale one is left to remove by hand
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        cerr << "Cannot create shared memory " << name << ": " << strerror(errno)
+             << (errno == EEXIST ? " (another server runs there, or remove /dev/shm" + string(name) + ")" : "") << "\n";
+        return 1;
+    }
+    if (ftruncate(fd, bytes) < 0)
+    {
+        cerr << "Cannot size shared memory " << name << ": " << strerror(errno) << "\n";
+        close(fd);
+        shm_unlink(name);
+        return 1;
+    }
+    void *region = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED)
+    {
+        cerr << "Cannot map shared memory " << name << ": " << strerror(errno) << "\n";
+        shm_unlink(name);
+        return 1;
+    }
+    memset(region, 0, bytes);
+    shm_header *h = (shm_header *) region;
+
+    signal(SIGINT, request_stop);
+    signal(SIGTERM, request_stop);
+
+    // The magic goes last so trainers never see a half written region
+    layout.magic = 0;
+    memcpy(h, &layout, sizeof(layout));
+    batch b;
+    setup_batch(&b, r, games, seed, true);
+    publish(h, b, e, 0);
+    __atomic_store_n(&h->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    cerr << "SERVING " << r.name << " games " << games << " slots " << slots << " at " << name << " (" << bytes << " bytes)\n";
+
+    uint32_t served = 0;
+    while (!STOP && !__atomic_load_n(&h->closing, __ATOMIC_ACQUIRE))
+    {
+        uint32_t asked = __atomic_load_n(&h->request, __ATOMIC_ACQUIRE);
+        if (asked == served)
+        {
+            futex_wait(&h->request, served, WAIT_MS);
+            continue;
+        }
+        // Actions are read in place from the slot, results written next to them
+        served++;
+        step_batch(&b, (const int32_t *) (slot_of(h, served) + h->actions_at));
+        publish(h, b, e, served);
+        __atomic_store_n(&h->response, served, __ATOMIC_RELEASE);
+        futex_wake(&h->response);
+    }
+
+    cerr << "STOPPED after " << served << " steps\n";
+    munmap(region, bytes);
+    shm_unlink(name);
+    return 0;
+}
+
+// Write the state after step n into its slot
+void publish(shm_header *h, const batch &b, const encoding &e, uint32_t n)
+{
+    uint8_t *slot = slot_of(h, n);
+    int32_t *head = (int32_t *) (slot + h->head_at);
+    for (int g = 0; g < b.games; g++)
+    {
+        head[g] = b.head_y[g] * b.r.columns + b.head_x[g];
+    }
+    memcpy(slot + h->items_at, b.item.data(), b.item.size());
+    memcpy(slot + h->moves_at, b.moves.data(), b.games * sizeof(int32_t));
+    memcpy(slot + h->score_at, b.score.data(), b.games * sizeof(int32_t));
+    memcpy(slot + h->reward_at, b.reward.data(), b.games * sizeof(int32_t));
+    memcpy(slot + h->done_at, b.done.data(), b.games);
+    memcpy(slot + h->death_at, b.death.data(), b.games);
+    if (e.type != NO_TENSOR)
+    {
+        encode_batch(b, e, slot + h->tensor_at);
+    }
+    return;
+}
+
+// Trainer side example: step a running server with random actions and time it
+int bench(const char *name, long steps, bool quit)
+{
+    shm_header *h = attach_shm(name);
+    if (h == NULL)
+    {
+        cerr << "No server at " << name << "\n";
+        return 1;
+    }
+    const rules &r = RULES[h->variant];
+    uint64_t seed = 7;
+    long ended = 0;
+    uint32_t n = __atomic_load_n(&h->response, __ATOMIC_ACQUIRE);
+
+    auto start = chrono::steady_clock::now();
+    for (long i = 0; i < steps; i++)
+    {
+        n++;
+        uint8_t *slot = slot_of(h, n);
+        int32_t *actions = (int32_t *) (slot + h->actions_at);
+        for (uint32_t g = 0; g < h->games; g++)
+        {
+            actions[g] = random_below(&seed, r.directions);
+        }
+        __atomic_store_n(&h->request, n, __ATOMIC_RELEASE);
+        futex_wake(&h->request);
+        while (__atomic_load_n(&h->response, __ATOMIC_ACQUIRE) != n)
+        {
+            futex_wait(&h->response, n - 1, WAIT_MS);
+        }
+        const uint8_t *done = slot + h->done_at;
+        for (uint32_t g = 0; g < h->games; g++)
+        {
+            ended += done[g];
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (steps > 0)
+    {
+        cout << "BENCH " << r.name << " games " << h->games << " steps " << steps
+             << " steps/s " << (long) (steps / seconds)
+             << " game steps/s " << (long) (steps * h->games / seconds)
+             << " games ended " << ended << "\n";
+    }
+
+    if (quit)
+    {
+        __atomic_store_n(&h->closing, 1, __ATOMIC_RELEASE);
+        futex_wake(&h->request);
+    }
+    munmap(h, shm_bytes(h));
+    return 0;
+}
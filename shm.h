@@ -0,0 +1,168 @@
+// SHARED MEMORY LAYOUT between the environment server and its trainers
+#ifndef SHM_H
+#define SHM_H
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "rules.h"
+
+// Constant: Header magic ("SNAK") and layout version
+const uint32_t SHM_MAGIC = 0x4B414E53;
+const uint32_t SHM_VERSION = 2;
+
+// Data type: Start of the region, the slots follow it.
+// Step n reads its actions from slot n % slots and writes its results to the same slot,
+// step 0 is the first observation after setup. A trainer fills the actions of step n,
+// then stores n in request and wakes it; the server answers by storing n in response
+// and waking that. Every array in a slot is indexed by game.
+struct shm_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t games;
+    uint32_t rows;
+    uint32_t columns;
+    uint32_t cells;
+    uint32_t slots;
+    uint32_t variant;
+    // Observation tensor written with every step (tensor_type and tensor_layout of encode.h)
+    uint32_t tensor_type;
+    uint32_t tensor_layout;
+    uint64_t tensor_game_bytes;
+    // Bytes of the header and of one slot, both multiples of 64
+    uint64_t header_bytes;
+    uint64_t slot_bytes;
+    // Offsets inside a slot
+    uint64_t actions_at;      // int32 action (index in KEYS)
+    uint64_t items_at;        // uint8 item bits per cell, games * cells
+    uint64_t head_at;         // int32 head cell
+    uint64_t moves_at;        // int32 moves left
+    uint64_t score_at;        // int32 score
+    uint64_t reward_at;       // int32 score gained by the step
+    uint64_t done_at;         // uint8 game ended on the step and restarted
+    uint64_t death_at;        // uint8 how it ended
+    uint64_t tensor_at;       // encoded games back to back, tensor_game_bytes each
+    // Futex words on cache lines of their own
+    alignas(64) uint32_t request;
+    alignas(64) uint32_t response;
+    // Set by a trainer to stop the server
+    alignas(64) uint32_t closing;
+};
+
+// Round up to a cache line
+inline uint64_t cache_lines(uint64_t bytes)
+{
+    return (bytes + 63) / 64 * 64;
+}
+
+// Fill the header of a region for games of rows x columns cells, with tensor_game_bytes
+// of observation tensor per game (0 for none)
+inline void layout_shm(shm_header *h, uint32_t games, uint32_t rows, uint32_t columns, uint32_t slots, uint32_t variant,
+                       uint32_t tensor_type, uint32_t tensor_layout, uint64_t tensor_game_bytes)
+{
+    h->magic = SHM_MAGIC;
+    h->version = SHM_VERSION;
+    h->games = games;
+    h->rows = rows;
+    h->columns = columns;
+    h->cells = rows * columns;
+    h->slots = slots;
+    h->variant = variant;
+    h->tensor_type = tensor_type;
+    h->tensor_layout = tensor_layout;
+    h->tensor_game_bytes = tensor_game_bytes;
+    h->header_bytes = cache_lines(sizeof(shm_header));
+
+    uint64_t at = 0;
+    h->actions_at = at;
+    at += cache_lines(games * 4ULL);
+    h->items_at = at;
+    at += cache_lines((uint64_t) games * h->cells);
+    h->head_at = at;
+    at += cache_lines(games * 4ULL);
+    h->moves_at = at;
+    at += cache_lines(games * 4ULL);
+    h->score_at = at;
+    at += cache_lines(games * 4ULL);
+    h->reward_at = at;
+    at += cache_lines(games * 4ULL);
+    h->done_at = at;
+    at += cache_lines(games);
+    h->death_at = at;
+    at += cache_lines(games);
+    h->tensor_at = at;
+    at += cache_lines(games * tensor_game_bytes);
+    h->slot_bytes = at;
+    h->request = 0;
+    h->response = 0;
+    h->closing = 0;
+    return;
+}
+
+// Bytes of the whole region
+inline uint64_t shm_bytes(const shm_header *h)
+{
+    return h->header_bytes + h->slots * h->slot_bytes;
+}
+
+// Start of the slot of step n
+inline uint8_t *slot_of(shm_header *h, uint32_t n)
+{
+    return (uint8_t *) h + h->header_bytes + (n % h->slots) * h->slot_bytes;
+}
+
+// Futex wait while *word still holds value, for at most ms milliseconds
+inline void futex_wait(uint32_t *word, uint32_t value, long ms)
+{
+    timespec timeout = {ms / 1000, (ms % 1000) * 1000000};
+    syscall(SYS_futex, word, FUTEX_WAIT, value, &timeout, NULL, 0);
+    return;
+}
+
+// Wake every process waiting on a futex word
+inline void futex_wake(uint32_t *word)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    return;
+}
+
+// Map an existing region read-write, NULL on failure
+inline shm_header *attach_shm(const char *name)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(shm_header))
+    {
+        close(fd);
+        return NULL;
+    }
+    void *region = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED)
+    {
+        return NULL;
+    }
+    // Nothing past the header is trusted until it proves to be ours and to fit the mapping
+    shm_header *h = (shm_header *) region;
+    if (h->magic != SHM_MAGIC || h->version != SHM_VERSION || h->variant >= VARIANTS || shm_bytes(h) > (uint64_t) st.st_size)
+    {
+        munmap(region, st.st_size);
+        return NULL;
+    }
+    return h;
+}
+
+#endif
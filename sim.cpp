@@ -0,0 +1,141 @@
+// HEADLESS SIMULATOR: plays many bot games on every core
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+
+#include "pool.h"
+
+using namespace std;
+
+// Prototypes
+void report(const rules &r, const stats &total, int threads, bool bitboards, const agent *bot, double seconds);
+void compare(const stats &planned, double planned_seconds, const stats &bfs, double bfs_seconds);
+
+int main(int argc, char *argv[])
+{
+    // Options: -v VARIANT picks the rules, -n GAMES to play, -t THREADS to use,
+    // -s SEED numbers the games from SEED, -c CHUNK games stepped together,
+    // -b plays on the bitboard engine instead of the batch, -p plays the budget planner
+    // and then the bfs agent on the same games instead of the greedy bot (on the bitboard
+    // engine) and compares them
+    const rules *r = &RULES[ECO];
+    long games = 10000;
+    int threads = thread::hardware_concurrency();
+    uint64_t seed = 1;
+    long chunk = CHUNK;
+    bool bitboards = false;
+    bool planned = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "v:n:t:s:c:bp")) != -1)
+    {
+        if (opt == 'v')
+        {
+            r = find_rules(optarg);
+            if (r == NULL)
+            {
+                cerr << "Unknown variant " << optarg << "\n";
+                return 1;
+            }
+        }
+        else if (opt == 'n')
+        {
+            games = atol(optarg);
+        }
+        else if (opt == 't')
+        {
+            threads = atoi(optarg);
+        }
+        else if (opt == 's')
+        {
+            seed = strtoull(optarg, NULL, 10);
+        }
+        else if (opt == 'c')
+        {
+            chunk = atol(optarg);
+        }
+        else if (opt == 'b')
+        {
+            bitboards = true;
+        }
+        else if (opt == 'p')
+        {
+            planned = true;
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-v VARIANT] [-n GAMES] [-t THREADS] [-s SEED] [-c CHUNK] [-b] [-p]\n";
+            return 1;
+        }
+    }
+    threads = max(threads, 1);
+    chunk = max(chunk, 1L);
+
+    bitboards = (bitboards || planned) && board_fits(*r);
+    planned = planned && bitboards;
+    vector<const agent *> bots = {NULL};
+    if (planned)
+    {
+        bots = {find_agent("budget"), find_agent("bfs")};
+    }
+    vector<stats> totals(bots.size());
+    vector<double> seconds(bots.size());
+    for (size_t i = 0; i < bots.size(); i++)
+    {
+        auto start = chrono::steady_clock::now();
+        totals[i] = {};
+        simulate(*r, seed, games, threads, chunk, bitboards, bots[i], &totals[i]);
+        seconds[i] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        report(*r, totals[i], threads, bitboards, bots[i], seconds[i]);
+    }
+    if (planned)
+    {
+        compare(totals[0], seconds[0], totals[1], seconds[1]);
+    }
+    return 0;
+}
+
+// Print throughput and the distributions of the finished games
+void report(const rules &r, const stats &total, int threads, bool bitboards, const agent *bot, double seconds)
+{
+    cout << "SIMULATION " << r.name << " games " << total.games << " threads " << threads
+         << " engine " << (bitboards ? "bitboard" : "batch") << " bot " << (bot != NULL ? bot->name : "greedy")
+         << " seconds " << fixed << setprecision(3) << seconds << "\n";
+    cout << "THROUGHPUT games/s " << setprecision(0) << total.games / seconds
+         << " ticks/s " << total.ticks / seconds << "\n";
+
+    const char *names[] = {"size", "score", "moves left"};
+    const vector<long> *all[] = {&total.size, &total.score, &total.moves};
+    cout << "RESULT           mean       p10       p50       p90       p99       max\n";
+    for (int i = 0; i < 3; i++)
+    {
+        cout << left << setw(12) << names[i] << right << setprecision(2)
+             << setw(9) << mean(*all[i], total.games)
+             << setw(10) << quantile(*all[i], total.games, 0.10)
+             << setw(10) << quantile(*all[i], total.games, 0.50)
+             << setw(10) << quantile(*all[i], total.games, 0.90)
+             << setw(10) << quantile(*all[i], total.games, 0.99)
+             << setw(10) << quantile(*all[i], total.games, 1.00) << "\n";
+    }
+
+    cout << "DEATH            games         %\n";
+    for (int d = 0; d < DEATHS; d++)
+    {
+        double share = total.games > 0 ? 100.0 * total.deaths[d] / total.games : 0;
+        cout << left << setw(12) << (d == NONE ? "tick limit" : DEATH_NAMES[d]) << right
+             << setw(10) << total.deaths[d] << setw(10) << setprecision(1) << share << "\n";
+    }
+    return;
+}
+
+// Print how the budget planner did against the bfs agent on the same games
+void compare(const stats &planned, double planned_seconds, const stats &bfs, double bfs_seconds)
+{
+    double score = mean(planned.score, planned.games) - mean(bfs.score, bfs.games);
+    double ticks = (double) planned.ticks / max(planned.games, 1L) - (double) bfs.ticks / max(bfs.games, 1L);
+    cout << "VERSUS bfs score " << showpos << setprecision(2) << score << " ticks/game " << ticks << noshowpos
+         << " speed " << (planned.ticks / planned_seconds) / (bfs.ticks / bfs_seconds) << "x\n";
+    return;
+}
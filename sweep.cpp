@@ -0,0 +1,289 @@
+// ECONOMY SWEEP: plays bot games under many price lists and writes the results as CSV
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "pool.h"
+
+using namespace std;
+
+// Data type: Values a swept parameter takes, low to high in steps
+struct axis
+{
+    int param;
+    double low;
+    double high;
+    double step;
+};
+
+// Prototypes
+bool parse_axis(const char *spec, axis *a);
+double get_param(const rules &r, int param);
+void set_param(rules *r, int param, double value);
+double snap(const axis &a, double value);
+void write_header(ostream &out);
+void write_row(ostream &out, const rules &r, const stats &total);
+
+int main(int argc, char *argv[])
+{
+    // Options: -v VARIANT picks the base rules, -p NAME=LOW:HIGH:STEP sweeps a parameter (repeat for a grid),
+    // -r SAMPLES draws random parameter sets instead of the grid, -n GAMES per set,
+    // -t THREADS to use, -s SEED fixes the games and the samples, -o FILE for the CSV
+    const rules *base = &RULES[ECO];
+    vector<axis> axes;
+    long samples = 0;
+    long games = 2000;
+    int threads = thread::hardware_concurrency();
+    uint64_t seed = 1;
+    const char *path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "v:p:r:n:t:s:o:")) != -1)
+    {
+        if (opt == 'v')
+        {
+            base = find_rules(optarg);
+            if (base == NULL)
+            {
+                cerr << "Unknown variant " << optarg << "\n";
+                return 1;
+            }
+        }
+        else if (opt == 'p')
+        {
+            axis a;
+            if (!parse_axis(optarg, &a))
+            {
+                cerr << "Bad sweep " << optarg << ", expected NAME=LOW:HIGH:STEP with NAME one of";
+                for (int p = 0; p < PRICE_PARAM_COUNT; p++)
+                {
+                    cerr << " " << PRICE_PARAMS[p];
+                }
+                cerr << "\n";
+                return 1;
+            }
+            axes.push_back(a);
+        }
+        else if (opt == 'r')
+        {
+            samples = atol(optarg);
+        }
+        else if (opt == 'n')
+        {
+            games = atol(optarg);
+        }
+        else if (opt == 't')
+        {
+            threads = atoi(optarg);
+        }
+        else if (opt == 's')
+        {
+            seed = strtoull(optarg, NULL, 10);
+        }
+        else if (opt == 'o')
+        {
+            path = optarg;
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-v VARIANT] [-p NAME=LOW:HIGH:STEP]... [-r SAMPLES] [-n GAMES] [-t THREADS] [-s SEED] [-o FILE]\n";
+            return 1;
+        }
+    }
+    threads = max(threads, 1);
+
+    ofstream file;
+    if (path != NULL)
+    {
+        file.open(path);
+        if (!file)
+        {
+            cerr << "Cannot write " << path << "\n";
+            return 1;
+        }
+    }
+    ostream &out = (path != NULL) ? file : cout;
+    write_header(out);
+
+    // Every set plays the same seeds so differences come from the prices alone
+    uint64_t sampler = seed;
+    vector<long> at(axes.size(), 0);
+    long sets = 0;
+    while (true)
+    {
+        rules r = *base;
+        for (size_t i = 0; i < axes.size(); i++)
+        {
+            double value;
+            if (samples > 0)
+            {
+                double u = (next_random(&sampler) >> 11) * (1.0 / 9007199254740992.0);
+                value = snap(axes[i], axes[i].low + u * (axes[i].high - axes[i].low));
+            }
+            else
+            {
+                value = axes[i].low + at[i] * axes[i].step;
+            }
+            set_param(&r, axes[i].param, value);
+        }
+
+        stats total = {};
+        simulate(r, seed, games, threads, CHUNK, true, NULL, &total);
+        write_row(out, r, total);
+        out.flush();
+        sets++;
+        if (path != NULL)
+        {
+            cerr << "\rsets " << sets << flush;
+        }
+
+        // Next random sample, or the next grid point in odometer order
+        if (samples > 0)
+        {
+            if (sets >= samples)
+            {
+                break;
+            }
+            continue;
+        }
+        size_t i = 0;
+        while (i < axes.size())
+        {
+            at[i]++;
+            if (axes[i].low + at[i] * axes[i].step <= axes[i].high + 1e-9)
+            {
+                break;
+            }
+            at[i] = 0;
+            i++;
+        }
+        if (i == axes.size())
+        {
+            break;
+        }
+    }
+    if (path != NULL)
+    {
+        cerr << "\n";
+    }
+    return 0;
+}
+
+// Read NAME=LOW:HIGH:STEP
+bool parse_axis(const char *spec, axis *a)
+{
+    const char *equals = strchr(spec, '=');
+    if (equals == NULL)
+    {
+        return false;
+    }
+    string name(spec, equals - spec);
+    a->param = -1;
+    for (int p = 0; p < PRICE_PARAM_COUNT; p++)
+    {
+        if (name == PRICE_PARAMS[p])
+        {
+            a->param = p;
+        }
+    }
+    if (a->param < 0 || sscanf(equals + 1, "%lf:%lf:%lf", &a->low, &a->high, &a->step) != 3)
+    {
+        return false;
+    }
+    return a->step > 0 && a->low <= a->high;
+}
+
+// Value of a parameter in a rule set
+double get_param(const rules &r, int param)
+{
+    const double prices[] = {r.prices.apple_base, r.prices.apple_decay, r.prices.apple_floor,
+                             r.prices.banana_base, r.prices.banana_decay, r.prices.banana_floor,
+                             r.prices.reward_rate, r.prices.reward_cap};
+    if (param == 8)
+    {
+        return r.trap_life;
+    }
+    else if (param == 9)
+    {
+        return r.moves;
+    }
+    return prices[param];
+}
+
+// Change a parameter of a rule set
+void set_param(rules *r, int param, double value)
+{
+    double *prices[] = {&r->prices.apple_base, &r->prices.apple_decay, &r->prices.apple_floor,
+                        &r->prices.banana_base, &r->prices.banana_decay, &r->prices.banana_floor,
+                        &r->prices.reward_rate, &r->prices.reward_cap};
+    if (param == 8)
+    {
+        r->trap_life = lround(value);
+    }
+    else if (param == 9)
+    {
+        r->moves = lround(value);
+    }
+    else
+    {
+        *prices[param] = value;
+    }
+    return;
+}
+
+// Round a sampled value to the steps of its axis, a step down when the nearest one lies past
+// the top of a range that is not a whole number of steps
+double snap(const axis &a, double value)
+{
+    double steps = round((value - a.low) / a.step);
+    if (a.low + steps * a.step > a.high)
+    {
+        steps--;
+    }
+    return a.low + steps * a.step;
+}
+
+// CSV columns: the rule set, then the averages and death shares of its games
+void write_header(ostream &out)
+{
+    out << "variant";
+    for (int p = 0; p < PRICE_PARAM_COUNT; p++)
+    {
+        out << "," << PRICE_PARAMS[p];
+    }
+    out << ",games,ticks_mean,size_mean,score_mean,score_p50,score_p90,moves_left_mean";
+    for (int d = 0; d < DEATHS; d++)
+    {
+        out << ",death_" << (d == NONE ? "tick_limit" : DEATH_NAMES[d]);
+    }
+    out << "\n";
+    return;
+}
+
+// One CSV row per rule set
+void write_row(ostream &out, const rules &r, const stats &total)
+{
+    out << r.name;
+    for (int p = 0; p < PRICE_PARAM_COUNT; p++)
+    {
+        out << "," << get_param(r, p);
+    }
+    long games = max(total.games, 1L);
+    out << "," << total.games
+        << "," << (double) total.ticks / games
+        << "," << mean(total.size, total.games)
+        << "," << mean(total.score, total.games)
+        << "," << quantile(total.score, total.games, 0.50)
+        << "," << quantile(total.score, total.games, 0.90)
+        << "," << mean(total.moves, total.games);
+    for (int d = 0; d < DEATHS; d++)
+    {
+        out << "," << (double) total.deaths[d] / games;
+    }
+    out << "\n";
+    return;
+}
@@ -1,15 +1,31 @@
 // ECONOMIC SNAKE (Teleport mode)
+#include <algorithm>
 #include <cctype>
+#include <cerrno>
+#include <climits>
+#include <csignal>
 #include <cstdio>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <limits>
+#include <string>
 #include <thread>
+#include <vector>
 #include <chrono>
 #include <termios.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "prices.h"
 
 using namespace std;
 
@@ -43,13 +59,218 @@ struct tile
 const int COLUMNS = 25;
 const int ROWS = 15;
 
-// Constant: Trap life span
-const int TRAP_LIFE = 125;
+// Global variables: Economy of the game, the recharge and reward prices, the trap life
+// span and the starting moves, changed with -P NAME=VALUE
+price_list ECONOMY = PRICES;
+int TRAP_LIFE = PRICE_TRAP_LIFE;
+int START_MOVES = PRICE_MOVES;
 const int TELEPORT_RESET = 20;
 
 // Global variable: 2D Grid of tiles
 tile GRID[ROWS][COLUMNS];
 
+// Constant: Ticks without input before the game pauses itself
+const int IDLE_TICKS = 10;
+
+// Constant: Latency histogram buckets (8 per doubling of microseconds)
+const int LAT_BUCKETS = 256;
+
+// Data type: Latency histogram in microseconds
+struct histogram
+{
+    const char *name;
+    long count;
+    long max;
+    long bucket[LAT_BUCKETS];
+};
+
+// Data type: Opt-in real-time tuning of the tick loop
+struct tuning
+{
+    int cpu; // CPU to pin the process to, -1 leaves it unpinned
+    bool fifo; // Run under SCHED_FIFO
+    bool lock; // Lock all memory against page faults
+    long spin; // Microseconds busy-waited before each tick instead of slept
+};
+
+// Data type: Precomputed next frame for one direction
+struct frame
+{
+    bool ready; // Direction is a plain move: no crash, eating, spawning or last move
+    string diff; // Escape codes redrawing only the cells and counters that change
+};
+
+// Constant: Directions precomputed every tick
+const char ARROWS[] = "WSDAUJKI";
+const int DIRECTIONS = 8;
+
+// Constant: Screen lines of the first grid row, of the moves counter and of the danger hint
+const int GRID_LINE = 5;
+const int MOVES_LINE = ROWS + 9;
+const int DANGER_LINE = MOVES_LINE + 1;
+
+// Global variable: Next frame for each direction
+frame NEXT[DIRECTIONS];
+
+// Global variables: Session latency histograms
+histogram INPUT_LAG = {"input -> flush", 0, 0, {}}; // Key readable on stdin to frame flushed
+histogram TICK_LAG = {"tick -> flush", 0, 0, {}}; // Tick fired to frame flushed
+histogram FLUSH_LAG = {"render -> flush", 0, 0, {}}; // Frame render start to frame flushed
+histogram WAKE_LAG = {"tick lateness", 0, 0, {}}; // Tick deadline to the loop waking up
+
+// Global variable: Real-time tuning, all off unless asked for on the command line
+tuning TUNING = {-1, false, false, 0};
+
+// Global variable: Raised by SIGUSR1 to dump the histograms mid-game
+volatile sig_atomic_t DUMP = 0;
+
+// Global variable: Autopilot steers, keys still pause, toggle the speed and override a tick
+bool AUTO = false;
+
+// Global variable: Danger hint under the moves counter, the keys whose step traps the snake
+bool DANGER = false;
+
+// Data type: Game state a keyframe holds besides the snake, the grid items and the random
+// stream
+struct counters
+{
+    char inertia;
+    char cursor;
+    int speed;
+    bool sped_up;
+    bool ate;
+    int size;
+    int score;
+    int moves;
+    long run;
+    int teleport_time;
+    int portal_x;
+    int portal_y;
+};
+
+// Constant: Replay files hold REPLAY_MAGIC, the version, the variant (its index in rules.h),
+// the bits per input record, the count and values of the rule constants, the seed and
+// REPLAY_KEYFRAME. Runs of REPLAY_KEYFRAME ticks follow, each a keyframe of the state before
+// its first tick and the input records of its ticks padded to a byte. Then the offsets of the
+// keyframes, REPLAY_END, their count, the offset of the index, the ticks and the final state
+const char REPLAY_MAGIC[] = "SNKR";
+const char REPLAY_END[] = "SNKE";
+const int REPLAY_VERSION = 3;
+const int REPLAY_VARIANT = 8;
+const int REPLAY_BITS = 4;
+int REPLAY_RULES[] = {COLUMNS, ROWS, PRICE_TRAP_LIFE, TELEPORT_RESET};
+const int REPLAY_RULE_COUNT = sizeof(REPLAY_RULES) / sizeof(REPLAY_RULES[0]);
+const int REPLAY_HEADER = 8 + 4 * REPLAY_RULE_COUNT + 8;
+const int REPLAY_FOOTER = 32;
+
+// Constant: Ticks between keyframes, a seek decodes the one before its tick and plays on
+// fewer ticks than this
+const int REPLAY_KEYFRAME = 256;
+
+// Constant: Keyframes hold the snake as its head cell and a nibble per node from the head,
+// the direction bits and KEYFRAME_OFF for a node off the trail of the one ahead of it whose
+// cell is kept after the nibbles. Numbers are kept in 7-bit groups
+const int KEYFRAME_OFF = 8;
+const int KEYFRAME_COUNTERS = 12;
+
+// Constant: Input records are the index of the cursor in ARROWS, or with REPLAY_FLAG set an
+// event coming before the cursor record of its tick, or REPLAY_KEEP for a cursor that is
+// not a direction and stays as it was
+const int REPLAY_FLAG = 8;
+const int REPLAY_KEEP = 0;
+const int REPLAY_SPEED = 1; // F toggled the speed
+const int REPLAY_JUMP = 2; // T teleported
+
+// Global variable: State of the spawn random stream, a keyframe holds it whole
+uint32_t RANDOM = 1;
+
+// Global variables: Replay written in the session unless -n, or read back by -p, the bits
+// packed for the next byte, the bit a playback reads next and the byte its records end at,
+// the ticks recorded or played, the offsets of the keyframes, the tick a playback seeks to
+// and whether every keyframe matched the state played up to it
+ofstream REPLAY_OUT;
+string REPLAY_IN;
+bool PLAYBACK = false;
+int REPLAY_BYTE = 0;
+int REPLAY_FILL = 0;
+size_t REPLAY_AT = 0;
+size_t REPLAY_STOP = 0;
+long REPLAY_TICKS = 0;
+long REPLAY_CLOCK = 0;
+vector<uint32_t> REPLAY_INDEX;
+long REPLAY_SEEK = -1;
+bool REPLAY_MATCH = true;
+
+// Constant: Autopilot grid with a wall border, steps of the ARROWS on it
+const int PILOT_WIDTH = COLUMNS + 2;
+const int PILOT_CELLS = (ROWS + 2) * PILOT_WIDTH;
+const int PILOT_STEP[] = {-PILOT_WIDTH, PILOT_WIDTH, 1, -1, -PILOT_WIDTH - 1, PILOT_WIDTH - 1, PILOT_WIDTH + 1, -PILOT_WIDTH + 1};
+
+// Constant: Steps a room holds the head per cell while the body moves off beside it
+const int ROOM_HOLD = 4;
+
+// Global variables: Autopilot scratch allocated once, the grid with a wall border where
+// cell (x, y) is (y + 1) * PILOT_WIDTH + x + 1, the search queue and visit stamps that
+// clear by bumping PILOT_STAMP
+bool PILOT_WALL[PILOT_CELLS];
+bool PILOT_GOAL[PILOT_CELLS];
+int PILOT_QUEUE[PILOT_CELLS];
+unsigned PILOT_SEEN[PILOT_CELLS + 1];
+unsigned PILOT_STAMP = 0;
+
+// Global variable: Body segment on each autopilot cell counted from the tail, -1 off the body
+int PILOT_ORDER[PILOT_CELLS];
+
+// Global variables: Cell of each body segment counted from the tail, how many there are,
+// and the stamp of the last search that ran into each of them
+int PILOT_BODY[PILOT_CELLS];
+int PILOT_LENGTH = 0;
+unsigned PILOT_TOUCHED[PILOT_CELLS];
+
+// Constant: Planner costs, MOVE_COST per move of the budget plus one per tick, so a straight
+// step costs 5 and a diagonal one, two moves in one tick, costs 9
+const int MOVE_COST = 4;
+const int STRAIGHT_COST = MOVE_COST + 1;
+const int DIAGONAL_COST = 2 * MOVE_COST + 1;
+const int PLAN_COST[] = {STRAIGHT_COST, STRAIGHT_COST, STRAIGHT_COST, STRAIGHT_COST,
+                         DIAGONAL_COST, DIAGONAL_COST, DIAGONAL_COST, DIAGONAL_COST};
+// Constant: Planner node past the last cell that every goal leads into
+const int PLAN_SINK = PILOT_CELLS;
+// Constant: Planner move through the open portal, after the ARROWS
+const int PLAN_TELEPORT = DIRECTIONS;
+
+// Global variables: Planner scratch, valid where PILOT_SEEN holds the current stamp: path cost,
+// estimated total cost, the node and move it is reached from, ticks from the start, heap
+// position and closed stamp of every node, then the heap of open nodes by estimate and the
+// goals with what eating them is worth
+int PLAN_G[PILOT_CELLS + 1];
+int PLAN_F[PILOT_CELLS + 1];
+int PLAN_FROM[PILOT_CELLS + 1];
+int PLAN_MOVE[PILOT_CELLS + 1];
+int PLAN_TICKS[PILOT_CELLS + 1];
+int PLAN_SLOT[PILOT_CELLS + 1];
+unsigned PLAN_CLOSED[PILOT_CELLS + 1];
+int PLAN_HEAP[PILOT_CELLS + 1];
+int PLAN_OPEN = 0;
+int PLAN_VALUE[PILOT_CELLS];
+int PLAN_GOALS[PILOT_CELLS];
+int PLAN_GOAL_COUNT = 0;
+int PLAN_BEST = 0;
+
+// Global variables: Portal the planner may jump to, -1 when closed, and the ticks it stays open
+int PLAN_PORTAL = -1;
+int PLAN_WINDOW = 0;
+
+// Global variables: Moves of the last plan (PLAN_TELEPORT for a jump) and the cells they lead
+// to from PATH_START, the next move to take, and the goal count and portal it was planned for
+int PATH_MOVE[PILOT_CELLS];
+int PATH_CELL[PILOT_CELLS];
+int PATH_START = -1;
+int PATH_LENGTH = 0;
+int PATH_NEXT = 0;
+int PATH_GOALS = 0;
+int PATH_PORTAL = -1;
+
 // Prototypes
 void spawn_apple(void);
 void spawn_trap(void);
@@ -57,6 +278,7 @@ void default_grid(void);
 void update_grid(node *tail);
 void print_grid(int size, int score, int moves, bool turbo_mode);
 void layout(void);
+const char *glyph(tile t, bool turbo_mode);
 void teleport_head(node *h, int x, int y);
 char backwards(char cursor);
 void point_head(char arrow, node *head, int *life);
@@ -68,7 +290,7 @@ bool intersect(node *head, node *tail);
 bool eat(node *head);
 bool hit(node *head);
 bool terminate_portal(node *head);
-void sizeup(node **tail, int *size);
+void sizeup(node **tail, node vacated, int *size);
 int speedup(int level, int tempo);
 void age(void);
 int recharge(int age);
@@ -77,11 +299,146 @@ void lfree(node *tail);
 void enable_live(void);
 void disable_live(void);
 char read_key(void);
-
-int main(void)
+char wait_key(long *deadline, long *arrival);
+char pause_game(void);
+long now_us(void);
+void record(histogram *h, long us);
+long percentile(histogram *h, double p);
+void dump_latency(void);
+void request_dump(int sig);
+void tune(void);
+long log_frame(long frame, long tick, long arrival);
+void speculate(node *head, node *tail, int moves, bool turbo_mode, long run, int teleport_time);
+bool flush_next(char cursor, long tick, long arrival, long *flushed);
+void diff_cell(string *diff, int y, int x, tile after, bool turbo_mode);
+void pilot_grid(node *tail);
+void next_stamp(void);
+int flood(int start, int limit);
+int escape(int start, int limit);
+void print_danger(node *head, node *tail, char inertia, int size);
+bool fits(int start, int landing, int size);
+char autopilot(node *head, node *tail, char inertia, int size, int portal_x, int portal_y, int teleport_time);
+int path_step(int start);
+int plan(int start, char inertia);
+int estimate(int c);
+int distance_cost(int c, int g);
+void relax(int n, int g, int from, int move);
+void heap_up(int i);
+void heap_down(int i);
+int next_random(void);
+void put32(ostream &out, uint32_t value);
+uint32_t get32(const string &in, size_t at);
+void put_number(string *out, long value);
+bool get_number(const string &in, size_t *at, long *value);
+uint32_t digest(node *tail);
+int heading(node *n);
+void set_heading(node *n, int code);
+void trail(node *lead, int *x, int *y);
+string encode_keyframe(node *head, node *tail, const counters &c);
+bool get_items(size_t *at, bool aged, vector<long> *items);
+bool decode_keyframe(size_t at, size_t end, long expect, node **head, node **tail, counters *c);
+bool start_replay(const char *path, unsigned seed);
+void keep_keyframe(node *head, node *tail, const counters &c);
+void put_record(int record);
+void record_tick(char cursor, char key);
+void finish_replay(int score, int size, int moves, node *tail);
+bool load_replay(const char *path, unsigned *seed);
+bool seek_replay(long tick, node **head, node **tail, counters *c);
+void print_seek(void);
+int get_record(void);
+void replay_tick(char *pilot, char *key);
+bool check_replay(int score, int size, int moves, node *tail);
+
+int main(int argc, char *argv[])
 {
-    // Seed for random coordinate GENERATION
-    srand(time(NULL));
+    // Options: -c CPU pins the game to a CPU, -r asks for SCHED_FIFO,
+    // -m locks memory, -w US busy-waits the last US microseconds of each tick,
+    // -a lets the autopilot steer, -d names the keys whose step traps the snake,
+    // -s SEED fixes the spawns, -o FILE names the replay (tele.replay by default), -n records
+    // none, -p FILE plays a replay back without drawing or pacing and checks its end, -j TICK
+    // with -p starts it at the keyframe before TICK and draws TICK, -P NAME=VALUE sets a price,
+    // the trap life or the starting moves by its sweep CSV column, a replay needs the same
+    // ones to play back
+    unsigned seed = time(NULL);
+    const char *replay = "tele.replay";
+    const char *playback = NULL;
+    long jump = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:rmw:ads:o:np:j:P:")) != -1)
+    {
+        if (opt == 'c')
+        {
+            TUNING.cpu = atoi(optarg);
+        }
+        else if (opt == 'r')
+        {
+            TUNING.fifo = true;
+        }
+        else if (opt == 'm')
+        {
+            TUNING.lock = true;
+        }
+        else if (opt == 'w')
+        {
+            TUNING.spin = atol(optarg);
+        }
+        else if (opt == 'a')
+        {
+            AUTO = true;
+        }
+        else if (opt == 'd')
+        {
+            DANGER = true;
+        }
+        else if (opt == 's')
+        {
+            seed = strtoul(optarg, NULL, 10);
+        }
+        else if (opt == 'o')
+        {
+            replay = optarg;
+        }
+        else if (opt == 'n')
+        {
+            replay = NULL;
+        }
+        else if (opt == 'p')
+        {
+            playback = optarg;
+        }
+        else if (opt == 'j')
+        {
+            jump = atol(optarg);
+        }
+        else if (opt == 'P')
+        {
+            if (!set_price(&ECONOMY, &TRAP_LIFE, &START_MOVES, optarg))
+            {
+                cerr << "Bad price " << optarg << ", expected NAME=VALUE with NAME a sweep CSV column\n";
+                return 1;
+            }
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-c CPU] [-r] [-m] [-w US] [-a] [-d] [-s SEED] [-o FILE | -n] [-p FILE [-j TICK]] [-P NAME=VALUE]...\n";
+            return 1;
+        }
+    }
+    // A replay only plays back with the trap life it was recorded with
+    REPLAY_RULES[2] = TRAP_LIFE;
+    tune();
+
+    // Seed for random coordinate GENERATION, a replay brings its own
+    if (playback != NULL && !load_replay(playback, &seed))
+    {
+        cerr << "Cannot play " << playback << "\n";
+        return 1;
+    }
+    RANDOM = seed;
+    if (!PLAYBACK && replay != NULL && !start_replay(replay, seed))
+    {
+        cerr << "Cannot write " << replay << ", playing without a replay\n";
+    }
 
     // Default head node setup
     node *head = new node;
@@ -112,7 +469,7 @@ int main(void)
     // Initial score
     int score = 0;
     // Initial moves
-    int moves = 50;
+    int moves = START_MOVES;
     // Game runtime
     long run = 0;
 
@@ -126,12 +483,56 @@ int main(void)
     spawn_apple(); // Spawn first apple before loop
     spawn_apple(); // Spawn second apple before loop
 
-    // Enable live mode for terminal input
-    enable_live(); 
+    // Enable live mode for terminal input, a playback draws nothing and reads no keys
+    if (!PLAYBACK)
+    {
+        enable_live();
+    }
+
+    // Dump latency histograms on SIGUSR1
+    signal(SIGUSR1, request_dump);
+
+    // Timestamps of the last tick, of the key it consumed and of the last flushed frame
+    long tick = 0;
+    long arrival = 0;
+    long flushed = 0;
+    // Frame of this tick was already flushed from the precomputed ones
+    bool drawn = false;
+    // Ticks in a row without input
+    int idle = 0;
+
+    // A seek starts from the keyframe before its tick
+    if (PLAYBACK && jump >= 0)
+    {
+        counters c;
+        if (!seek_replay(jump, &head, &tail, &c))
+        {
+            cerr << "Cannot seek to tick " << jump << "\n";
+            return 1;
+        }
+        inertia = c.inertia;
+        cursor = c.cursor;
+        SPEED = c.speed;
+        sped_up = c.sped_up;
+        ate = c.ate;
+        size = c.size;
+        score = c.score;
+        moves = c.moves;
+        run = c.run;
+        teleport_time = c.teleport_time;
+        portal_x = c.portal_x;
+        portal_y = c.portal_y;
+    }
 
     // Loop game
     while (moves > 0)
     {
+        // Keyframe of the state before every REPLAY_KEYFRAME ticks
+        if (REPLAY_TICKS % REPLAY_KEYFRAME == 0)
+        {
+            counters now = {inertia, cursor, SPEED, sped_up, ate, size, score, moves, run, teleport_time, portal_x, portal_y};
+            keep_keyframe(head, tail, now);
+        }
         run++;
         // Default grid setup for snake positions
         default_grid();
@@ -146,7 +547,22 @@ int main(void)
         }
 
         // Print grid with snake, trap and apple positions
-        print_grid(size, score, moves, sped_up);
+        if (!drawn && (!PLAYBACK || REPLAY_TICKS == REPLAY_SEEK))
+        {
+            long frame = now_us();
+            print_grid(size, score, moves, sped_up);
+            flushed = log_frame(frame, tick, arrival);
+        }
+        // The tick a playback seeks to comes with the time the seek took
+        if (PLAYBACK && REPLAY_TICKS == REPLAY_SEEK)
+        {
+            print_seek();
+        }
+        // Keys that trap the snake, once the frame of this tick is out
+        if (DANGER && !PLAYBACK)
+        {
+            print_danger(head, tail, inertia, size);
+        }
 
         // Speed up when F is pressed
         if (sped_up)
@@ -158,12 +574,56 @@ int main(void)
             pace = SPEED;
         }
 
-        // Adjust Game speed
-        this_thread::sleep_for(chrono::milliseconds(pace)); // Sleep to reduce flickering
+        char pilot = 0;
+        char key = 0;
+        if (PLAYBACK)
+        {
+            // Recorded input of the tick, straight away
+            replay_tick(&pilot, &key);
+        }
+        else
+        {
+            // Precompute the next frame of every direction inside the tick budget
+            long deadline = flushed + pace * 1000L;
+            speculate(head, tail, moves, sped_up, run, teleport_time);
+            // The autopilot decides inside the tick budget as well
+            pilot = AUTO ? autopilot(head, tail, inertia, size, portal_x, portal_y, teleport_time) : 0;
+
+            // Prompt user for valid key input for cursor
+            key = wait_key(&deadline, &arrival); // Sleep out the tick, pausing on P, then hand over the key
+            tick = now_us();
+        }
 
-        // Prompt user for valid key input for cursor
-        char key;
-        key = read_key(); // Read key input without blocking
+        // Pause by itself once the player has been away for IDLE_TICKS ticks,
+        // never while the autopilot plays or a replay runs
+        if (key == 0 && !AUTO && !PLAYBACK)
+        {
+            idle++;
+        }
+        else
+        {
+            idle = 0;
+        }
+        if (idle >= IDLE_TICKS)
+        {
+            key = pause_game();
+            tick = now_us();
+            arrival = (key != 0) ? tick : 0;
+            idle = 0;
+        }
+        // Autopilot move, a direction key pressed this tick still wins,
+        // it teleports by pressing T for the player
+        if (pilot == 'T')
+        {
+            if (key == 0)
+            {
+                key = 'T';
+            }
+        }
+        else if (pilot != 0)
+        {
+            cursor = pilot;
+        }
         if (key != 0)
         {
             // Convert key to uppercase
@@ -199,8 +659,17 @@ int main(void)
             }
         }
 
+        // Keep the input of the tick for the replay
+        record_tick(cursor, key);
+
+        // Flush the precomputed frame of this move before updating the state,
+        // speed toggles recolour the whole snake and take the full redraw
+        drawn = !PLAYBACK && key != 'F' && !teleporting && flush_next(cursor, tick, arrival, &flushed);
+
         inertia = backwards(cursor); // Update inertia to opposite of cursor
         point_head(cursor, head, &moves); // Point head in cursor direction
+        // Tail as it was before the move, the snake grows into its cell
+        node vacated = *tail;
         // Move snake nodes towards their directions and updating directions
         move_snake(tail, teleporting);
         // Manually place head if teleport was activated
@@ -239,7 +708,7 @@ int main(void)
             GRID[head->y][head->x].apple_age = 0;
             ate = true;
 
-            sizeup(&tail, &size); // Upgrade
+            sizeup(&tail, vacated, &size); // Upgrade
             SPEED = speedup(size, SPEED);
         }
         // Terminate portal is head hits it
@@ -264,8 +733,8 @@ int main(void)
             // Spawn portal
             do
             {
-                portal_y = (int) rand() % ROWS;
-                portal_x = (int) rand() % COLUMNS;
+                portal_y = next_random() % ROWS;
+                portal_x = next_random() % COLUMNS;
             }
             while (GRID[portal_y][portal_x].snake || GRID[portal_y][portal_x].apple || GRID[portal_y][portal_x].trap); // Avoid snake, apple and trap positions
 
@@ -283,18 +752,38 @@ int main(void)
         }
     }
 
+    // Check a playback against the end its replay recorded, or finish the replay
+    bool same = true;
+    if (PLAYBACK)
+    {
+        same = check_replay(score, size, moves, tail);
+    }
+    else
+    {
+        finish_replay(score, size, moves, tail);
+    }
+
     // Recursively free the snake list
     lfree(tail);
 
     // Disable live mode and restore terminal settings
-    disable_live();
+    if (!PLAYBACK)
+    {
+        disable_live();
+    }
 
     if (moves <= 0)
     {
         cout << "\n\033[1;31mOUT OF MOVES!!\033[0m\n";
     }
     
-    return 0;
+    // Session latency report
+    if (!PLAYBACK)
+    {
+        dump_latency();
+    }
+
+    return same ? 0 : 3;
 }
 
 // Spawn apple in random position on grid
@@ -303,8 +792,8 @@ void spawn_apple(void)
     int x, y;
     do
     {
-        y = (int) rand() % ROWS;
-        x = (int) rand() % COLUMNS;
+        y = next_random() % ROWS;
+        x = next_random() % COLUMNS;
     }
     while (GRID[y][x].snake || GRID[y][x].apple || GRID[y][x].trap); // Avoid snake, apple and trap positions
 
@@ -319,8 +808,8 @@ void spawn_trap(void)
     int x, y;
     do
     {
-        y = (int) rand() % ROWS;
-        x = (int) rand() % COLUMNS;
+        y = next_random() % ROWS;
+        x = next_random() % COLUMNS;
     }
     while (GRID[y][x].snake || GRID[y][x].apple || GRID[y][x].trap); // Avoid snake, apple and trap positions
 
@@ -371,34 +860,7 @@ void print_grid(int size, int score, int moves, bool turbo_mode)
         cout << "#";
         for (int j = 0; j < COLUMNS; j++)
         {
-            if (GRID[i][j].trap)
-            {
-                cout << "X"; // Trap: X
-            }
-            else if (GRID[i][j].apple)
-            {
-                cout << "\033[31mA\033[0m"; // Apple: A
-            }
-            else if (GRID[i][j].snake)
-            {
-                if (turbo_mode)
-                {
-                    cout << "\033[35mO\033[0m"; // Turbo Snake: O - Purple
-                }
-                else
-                {
-                    cout << "\033[32mO\033[0m"; // Normal Snake: O - Green
-                }
-
-            }
-            else if (GRID[i][j].portal)
-            {
-                cout << "\033[33mT\033[0m"; // Portal: T (yellow)
-            }
-            else
-            {
-                cout << " ";
-            }
+            cout << glyph(GRID[i][j], turbo_mode);
         }
         cout << "#\n";
     }
@@ -425,10 +887,45 @@ void print_grid(int size, int score, int moves, bool turbo_mode)
     cout << "   \033[32mJ\033[0m \033[34mS\033[0m \033[32mK\033[0m\n";
     cout << "     v\n\n";
 
+    // Pause key
+    cout << "PAUSE: \033[34mP\033[0m\n\n";
+
     cout.flush(); // Flush the output buffer to ensure all output is printed
     return;
 }
 
+// Screen glyph of a tile: trap over apple over snake over portal
+const char *glyph(tile t, bool turbo_mode)
+{
+    if (t.trap)
+    {
+        return "X"; // Trap: X
+    }
+    else if (t.apple)
+    {
+        return "\033[31mA\033[0m"; // Apple: A
+    }
+    else if (t.snake)
+    {
+        if (turbo_mode)
+        {
+            return "\033[35mO\033[0m"; // Turbo Snake: O - Purple
+        }
+        else
+        {
+            return "\033[32mO\033[0m"; // Normal Snake: O - Green
+        }
+    }
+    else if (t.portal)
+    {
+        return "\033[33mT\033[0m"; // Portal: T (yellow)
+    }
+    else
+    {
+        return " ";
+    }
+}
+
 // Brick (#) Boundaries
 void layout(void)
 {
@@ -667,71 +1164,18 @@ bool terminate_portal(node *head)
     }
 }
 
-// Upgarde snake list by appending node to the tail
-void sizeup(node **tail, int *size)
+// Upgarde snake list by appending node to the tail on the cell it just left, as it was there
+void sizeup(node **tail, node vacated, int *size)
 {
     node *t = *tail;
 
     // Allocate a new node
     node *n = new node;
 
-    // On grid, Place new node behind tail node
-    n->prev = NULL;
-    int polar = 0;
-    if (t->axis)
-    {
-        if (t->direction)
-        {
-            n->y = t->y - 1;
-            polar = 1;
-        }
-        else
-        {
-            n->y = t->y + 1;
-            polar = -1;
-        }
-        if (t->diagonal == true)
-        {
-            n->x = t->x + polar;
-        }
-        else
-        {
-            n->x = t->x;
-        }
-    }
-    else
-    {
-        if (t->direction)
-        {
-            n->x = t->x - 1;
-            polar = -1;
-        }
-        else
-        {
-            n->x = t->x + 1;
-            polar = 1;
-        }
-        if (t->diagonal == true)
-        {
-            n->y = t->y + polar;
-        }
-        else
-        {
-            n->y = t->y;
-        }
-    }
-
-    // If new node is out of bounds, do not append and return
-    if (n->x < 0 || n->x >= COLUMNS || n->y < 0 || n->y >= ROWS)
-    {
-        delete n; // Delete new node
-        return;
-    }
-
-    // Inherit directions form tail node
-    n->axis = t->axis;
-    n->direction = t->direction;
-    n->diagonal = t->diagonal;
+    // On grid, Place new node where the tail was before the move, heading the way the tail
+    // left it. Behind the tail by its new direction lands on the body or off the grid at a
+    // bend, and past a portal is nowhere near it
+    *n = vacated;
 
     // Append new node to tail without orphaning
     n->prev = t;
@@ -839,10 +1283,10 @@ char read_key(void)
 // Recharge moves based on apple age
 int recharge(int age)
 {
-    int moves = 21 - (age * 0.70);
-    if (moves < 8)
+    int moves = ECONOMY.apple_base - (age * ECONOMY.apple_decay);
+    if (moves < ECONOMY.apple_floor)
     {
-        return 8;
+        return ECONOMY.apple_floor;
     }
     else
     {
@@ -853,13 +1297,1380 @@ int recharge(int age)
 // Reward score based on apple age
 int reward(int age)
 {
-    int points = age * 0.5;
-    if (points > 10)
+    int points = age * ECONOMY.reward_rate;
+    if (points > ECONOMY.reward_cap)
     {
-         return 10;
+         return ECONOMY.reward_cap;
     }
     else
     {
          return points;
     }
 }
+
+// Latency instrumentation
+
+// Sleep until the tick deadline, reading the first key as soon as it arrives
+// The pause key blocks here and pushes the deadline back by the time spent paused
+char wait_key(long *deadline, long *arrival)
+{
+    pollfd input = {STDIN_FILENO, POLLIN, 0};
+    bool heard = false;
+    char key = 0;
+
+    *arrival = 0;
+    for (long left = *deadline - now_us(); left > 0; left = *deadline - now_us())
+    {
+        // Sleep up to the spin window, then busy-wait for a punctual wake-up
+        long nap = left - TUNING.spin;
+        if (nap < 0)
+        {
+            nap = 0;
+        }
+
+        if (heard)
+        {
+            this_thread::sleep_for(chrono::microseconds(nap));
+        }
+        else
+        {
+            timespec timeout = {nap / 1000000, (nap % 1000000) * 1000};
+            if (ppoll(&input, 1, &timeout, NULL) > 0)
+            {
+                heard = true;
+                *arrival = now_us();
+                key = read_key();
+
+                // Resume restores the tick phase, the rest of the tick can still take a key
+                if (toupper(key) == 'P')
+                {
+                    key = pause_game();
+                    *deadline += now_us() - *arrival;
+                    *arrival = now_us();
+                    heard = (key != 0);
+                }
+            }
+        }
+    }
+    record(&WAKE_LAG, now_us() - *deadline);
+
+    if (key == 0)
+    {
+        *arrival = 0;
+    }
+    return key;
+}
+
+// Block on input with no timer and no rendering until a key resumes the game
+// Returns the resume key so it plays this tick, 0 when it was the pause key
+char pause_game(void)
+{
+    cout << "\033[1;33mPAUSED\033[0m (any key resumes)" << flush;
+
+    pollfd input = {STDIN_FILENO, POLLIN, 0};
+    bool resumed = false;
+    char key = 0;
+    while (!resumed)
+    {
+        // Only a key, closed input or a signal wakes the process up
+        if (poll(&input, 1, -1) > 0)
+        {
+            key = read_key();
+            resumed = true;
+        }
+        if (DUMP)
+        {
+            dump_latency();
+            DUMP = 0;
+        }
+    }
+
+    // Erase the banner
+    cout << "\r\033[K" << flush;
+
+    if (toupper(key) == 'P')
+    {
+        return 0;
+    }
+    return key;
+}
+
+// Monotonic clock in microseconds
+long now_us(void)
+{
+    return chrono::duration_cast <chrono::microseconds> (chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Add a latency sample to a histogram
+// Buckets are linear below 8us, then 8 per doubling so each is within 12.5%
+void record(histogram *h, long us)
+{
+    if (us < 0)
+    {
+        us = 0;
+    }
+
+    int b = us;
+    if (us >= 8)
+    {
+        int e = 3;
+        while ((us >> (e + 1)) != 0)
+        {
+            e++;
+        }
+        b = (e - 2) * 8 + ((us >> (e - 3)) & 7);
+    }
+    if (b >= LAT_BUCKETS)
+    {
+        b = LAT_BUCKETS - 1;
+    }
+
+    h->bucket[b]++;
+    h->count++;
+    if (us > h->max)
+    {
+        h->max = us;
+    }
+    return;
+}
+
+// Lower bound of the bucket holding the p-th fraction of samples
+long percentile(histogram *h, double p)
+{
+    long rank = (long) (p * h->count);
+    long seen = 0;
+    for (int b = 0; b < LAT_BUCKETS; b++)
+    {
+        seen += h->bucket[b];
+        if (seen > rank)
+        {
+            long low = b;
+            if (b >= 8)
+            {
+                low = (long) (8 + b % 8) << (b / 8 - 1);
+            }
+            return (low < h->max) ? low : h->max;
+        }
+    }
+    return h->max;
+}
+
+// Print p50 / p99 / max of every histogram to stderr
+void dump_latency(void)
+{
+    histogram *all[] = {&INPUT_LAG, &TICK_LAG, &FLUSH_LAG, &WAKE_LAG};
+
+    cerr << "\nTUNING cpu " << TUNING.cpu << " fifo " << TUNING.fifo << " mlock " << TUNING.lock << " spin " << TUNING.spin << "us\n";
+    cerr << "LATENCY (us)       count       p50       p99       max\n";
+    for (histogram *h : all)
+    {
+        cerr << left << setw(15) << h->name << right
+             << setw(10) << h->count
+             << setw(10) << percentile(h, 0.50)
+             << setw(10) << percentile(h, 0.99)
+             << setw(10) << h->max << "\n";
+    }
+    return;
+}
+
+// SIGUSR1 handler: dump at the next frame
+void request_dump(int sig)
+{
+    (void) sig;
+    DUMP = 1;
+    return;
+}
+
+// Apply the requested real-time tuning, dropping whatever the system refuses
+void tune(void)
+{
+    if (TUNING.cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(TUNING.cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        {
+            cerr << "Cannot pin to CPU " << TUNING.cpu << ": " << strerror(errno) << "\n";
+            TUNING.cpu = -1;
+        }
+    }
+    if (TUNING.fifo)
+    {
+        sched_param param = {};
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        if (sched_setscheduler(0, SCHED_FIFO, &param) != 0)
+        {
+            cerr << "SCHED_FIFO not permitted: " << strerror(errno) << "\n";
+            TUNING.fifo = false;
+        }
+    }
+    if (TUNING.lock)
+    {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+        {
+            cerr << "Cannot lock memory: " << strerror(errno) << "\n";
+            TUNING.lock = false;
+        }
+    }
+    return;
+}
+
+// Record the latencies of a frame flushed just now, returns the flush time
+long log_frame(long frame, long tick, long arrival)
+{
+    long flushed = now_us();
+
+    // Latency from input arrival, tick and render start to the flushed frame
+    record(&FLUSH_LAG, flushed - frame);
+    if (tick != 0)
+    {
+        record(&TICK_LAG, flushed - tick);
+    }
+    if (arrival != 0)
+    {
+        record(&INPUT_LAG, flushed - arrival);
+    }
+    if (DUMP)
+    {
+        dump_latency();
+        DUMP = 0;
+    }
+    return flushed;
+}
+
+// Speculation
+
+// Precompute the next frame of every direction while the tick sleeps
+// Only plain moves are precomputed, crashes, eating, portals and the last move take the full redraw
+void speculate(node *head, node *tail, int moves, bool turbo_mode, long run, int teleport_time)
+{
+    for (int d = 0; d < DIRECTIONS; d++)
+    {
+        NEXT[d].ready = false;
+    }
+
+    // Portal spawns draw random numbers, leave those ticks to the full redraw
+    if ((run % TELEPORT_RESET) == 0)
+    {
+        return;
+    }
+
+    // Traps that expire on this tick's age() vanish whatever the direction
+    string expired;
+    for (int i = 0; i < ROWS; i++)
+    {
+        for (int j = 0; j < COLUMNS; j++)
+        {
+            tile after = GRID[i][j];
+            if (GRID[i][j].trap && GRID[i][j].trap_age + 1 >= TRAP_LIFE)
+            {
+                after.trap = false;
+            }
+            // Portal closes once its time has run out
+            if (GRID[i][j].portal && teleport_time == 0)
+            {
+                after.portal = false;
+            }
+            diff_cell(&expired, i, j, after, turbo_mode);
+        }
+    }
+
+    for (int d = 0; d < DIRECTIONS; d++)
+    {
+        // Move a copy of the head the way the tick would
+        node lead = *head;
+        int cost = 0;
+        point_head(ARROWS[d], &lead, &cost);
+        move_node(&lead);
+
+        if (lead.x < 0 || lead.x >= COLUMNS || lead.y < 0 || lead.y >= ROWS)
+        {
+            continue;
+        }
+        if (GRID[lead.y][lead.x].apple || GRID[lead.y][lead.x].trap || GRID[lead.y][lead.x].portal || moves + cost - 1 <= 0)
+        {
+            continue;
+        }
+
+        // Body nodes shift into the cells ahead of them, only the tail cell is vacated
+        bool bitten = false;
+        for (node *ptr = tail->prev; ptr != NULL; ptr = ptr->prev)
+        {
+            if (ptr->x == lead.x && ptr->y == lead.y)
+            {
+                bitten = true;
+            }
+        }
+        if (bitten)
+        {
+            continue;
+        }
+
+        string *diff = &NEXT[d].diff;
+        *diff = "\0337"; // Save cursor
+        if (tail->x != lead.x || tail->y != lead.y)
+        {
+            tile vacated = GRID[tail->y][tail->x];
+            vacated.snake = false;
+            diff_cell(diff, tail->y, tail->x, vacated, turbo_mode);
+        }
+        tile entered = GRID[lead.y][lead.x];
+        entered.snake = true;
+        diff_cell(diff, lead.y, lead.x, entered, turbo_mode);
+        *diff += expired;
+
+        // Moves counter, cleared to the end of line in case it loses a digit
+        *diff += "\033[" + to_string(MOVES_LINE) + ";1HMOVES LEFT : \033[1;33m" + to_string(moves + cost - 1) + "\033[0m\033[K";
+        *diff += "\0338"; // Restore cursor
+        NEXT[d].ready = true;
+    }
+    return;
+}
+
+// Write the precomputed frame of the chosen direction if there is one
+bool flush_next(char cursor, long tick, long arrival, long *flushed)
+{
+    const char *arrow = strchr(ARROWS, cursor);
+    if (cursor == 0 || arrow == NULL || !NEXT[arrow - ARROWS].ready)
+    {
+        return false;
+    }
+
+    // Single buffer write on the tick's critical path
+    long frame = now_us();
+    const string &diff = NEXT[arrow - ARROWS].diff;
+    cout.write(diff.data(), diff.size());
+    cout.flush();
+
+    *flushed = log_frame(frame, tick, arrival);
+    return true;
+}
+
+// Append a redraw of one cell to a diff if its glyph changes
+void diff_cell(string *diff, int y, int x, tile after, bool turbo_mode)
+{
+    const char *next = glyph(after, turbo_mode);
+    if (strcmp(glyph(GRID[y][x], turbo_mode), next) != 0)
+    {
+        *diff += "\033[" + to_string(GRID_LINE + y) + ";" + to_string(x + 2) + "H" + next;
+    }
+    return;
+}
+
+// Autopilot
+
+// Copy the grid into the walled autopilot grid: snake and trap cells and the border are walls,
+// the tail cell is free since the tail moves on first, apples are goals with their value
+void pilot_grid(node *tail)
+{
+    for (int c = 0; c < PILOT_CELLS; c++)
+    {
+        PILOT_WALL[c] = true;
+        PILOT_GOAL[c] = false;
+        PILOT_ORDER[c] = -1;
+    }
+    PLAN_GOAL_COUNT = 0;
+    PLAN_BEST = 0;
+    for (int y = 0; y < ROWS; y++)
+    {
+        for (int x = 0; x < COLUMNS; x++)
+        {
+            int c = (y + 1) * PILOT_WIDTH + x + 1;
+            PILOT_WALL[c] = GRID[y][x].snake || GRID[y][x].trap;
+            PILOT_GOAL[c] = GRID[y][x].apple;
+            if (PILOT_GOAL[c])
+            {
+                // Apples are worth their recharge and reward
+                PLAN_VALUE[c] = recharge(GRID[y][x].apple_age) + reward(GRID[y][x].apple_age);
+                PLAN_BEST = max(PLAN_BEST, PLAN_VALUE[c]);
+                PLAN_GOALS[PLAN_GOAL_COUNT++] = c;
+            }
+        }
+    }
+    // Segments in the order they move off
+    int order = 0;
+    for (node *ptr = tail; ptr != NULL; ptr = ptr->prev)
+    {
+        PILOT_BODY[order] = (ptr->y + 1) * PILOT_WIDTH + ptr->x + 1;
+        PILOT_ORDER[PILOT_BODY[order]] = order;
+        order++;
+    }
+    PILOT_LENGTH = order;
+    PILOT_WALL[(tail->y + 1) * PILOT_WIDTH + tail->x + 1] = false;
+    return;
+}
+
+// Start a new search, the visit stamps only need clearing when the counter wraps
+void next_stamp(void)
+{
+    PILOT_STAMP++;
+    if (PILOT_STAMP == 0)
+    {
+        memset(PILOT_SEEN, 0, sizeof(PILOT_SEEN));
+        memset(PILOT_TOUCHED, 0, sizeof(PILOT_TOUCHED));
+        memset(PLAN_CLOSED, 0, sizeof(PLAN_CLOSED));
+        PILOT_STAMP = 1;
+    }
+    return;
+}
+
+// Count the free cells reachable from start not visited since the last stamp,
+// stop counting at limit
+int flood(int start, int limit)
+{
+    int front = 0;
+    int back = 0;
+    PILOT_SEEN[start] = PILOT_STAMP;
+    PILOT_QUEUE[back++] = start;
+    while (front < back && back < limit)
+    {
+        int c = PILOT_QUEUE[front++];
+        for (int d = 0; d < DIRECTIONS; d++)
+        {
+            int n = c + PILOT_STEP[d];
+            if (PILOT_WALL[n] || PILOT_SEEN[n] == PILOT_STAMP)
+            {
+                continue;
+            }
+            PILOT_SEEN[n] = PILOT_STAMP;
+            PILOT_QUEUE[back++] = n;
+        }
+    }
+    return back;
+}
+
+// Count the cells reachable from start like flood, and the body cells next to them once
+// the room can hold the head until they move off: segment i from the tail moves off after
+// i + 1 steps, so the tail cell is free from the start, and a room of n cells holds the
+// head for n / ROOM_HOLD steps. The search stamps the segments it runs into and walks
+// the body once from the tail, each segment it frees carrying the search on from its cell
+int escape(int start, int limit)
+{
+    int front = 0;
+    int back = 0;
+    int freed = 1;
+    PILOT_SEEN[start] = PILOT_STAMP;
+    PILOT_QUEUE[back++] = start;
+    while (back < limit)
+    {
+        while (front < back && back < limit)
+        {
+            int c = PILOT_QUEUE[front++];
+            for (int d = 0; d < DIRECTIONS; d++)
+            {
+                int n = c + PILOT_STEP[d];
+                if (PILOT_SEEN[n] == PILOT_STAMP)
+                {
+                    continue;
+                }
+                if (PILOT_WALL[n] && (PILOT_ORDER[n] < 0 || PILOT_ORDER[n] >= freed))
+                {
+                    if (PILOT_ORDER[n] >= 0)
+                    {
+                        PILOT_TOUCHED[PILOT_ORDER[n]] = PILOT_STAMP;
+                    }
+                    continue;
+                }
+                PILOT_SEEN[n] = PILOT_STAMP;
+                PILOT_QUEUE[back++] = n;
+            }
+        }
+        // The segment next to the room that moves off first
+        int next = freed;
+        while (next < PILOT_LENGTH && PILOT_TOUCHED[next] != PILOT_STAMP)
+        {
+            next++;
+        }
+        if (back >= limit || next >= PILOT_LENGTH || next * ROOM_HOLD > back)
+        {
+            break;
+        }
+        freed = next + 1;
+        PILOT_SEEN[PILOT_BODY[next]] = PILOT_STAMP;
+        PILOT_QUEUE[back++] = PILOT_BODY[next];
+    }
+    return back;
+}
+
+// Danger hint under the moves counter: the keys whose step does not crash but leads into
+// a room that cannot hold the snake
+void print_danger(node *head, node *tail, char inertia, int size)
+{
+    pilot_grid(tail);
+    int start = (head->y + 1) * PILOT_WIDTH + head->x + 1;
+    string keys;
+    for (int d = 0; d < DIRECTIONS; d++)
+    {
+        int n = start + PILOT_STEP[d];
+        if (ARROWS[d] == inertia || PILOT_WALL[n])
+        {
+            continue;
+        }
+        next_stamp();
+        PILOT_SEEN[start] = PILOT_STAMP;
+        if (escape(n, size + 1) <= size)
+        {
+            keys += ' ';
+            keys += ARROWS[d];
+        }
+    }
+    cout << "\0337\033[" << DANGER_LINE << ";1H";
+    if (!keys.empty())
+    {
+        cout << "DANGER :\033[1;31m" << keys << "\033[0m";
+    }
+    cout << "\033[K\0338";
+    cout.flush();
+    return;
+}
+
+// The snake still fits in the room behind a step from start to landing
+bool fits(int start, int landing, int size)
+{
+    next_stamp();
+    PILOT_SEEN[start] = PILOT_STAMP;
+    return escape(landing, size + 1) > size;
+}
+
+// Autopilot move: A* to the apple that costs the least to reach and is worth
+// the most, through the portal while it is open, taken when the snake still fits in the room
+// behind the first step, otherwise the step with the most room. The path is kept and
+// followed until the apples or the portal change or it runs into something
+char autopilot(node *head, node *tail, char inertia, int size, int portal_x, int portal_y, int teleport_time)
+{
+    pilot_grid(tail);
+    PLAN_PORTAL = (teleport_time > 0) ? (portal_y + 1) * PILOT_WIDTH + portal_x + 1 : -1;
+    PLAN_WINDOW = teleport_time;
+    int start = (head->y + 1) * PILOT_WIDTH + head->x + 1;
+    int step = path_step(start);
+    if (step >= 0 && !fits(start, PATH_CELL[PATH_NEXT], size))
+    {
+        step = -1;
+    }
+    if (step < 0)
+    {
+        step = plan(start, inertia);
+    }
+    if (step >= 0 && fits(start, PATH_CELL[PATH_NEXT], size))
+    {
+        PATH_NEXT++;
+        return (step == PLAN_TELEPORT) ? 'T' : ARROWS[step];
+    }
+    PATH_LENGTH = 0;
+
+    // No apple in reach or no room behind it, one stamp for every step so each
+    // region is counted once, a step into a counted region has no more room
+    int best = -1;
+    int room = 0;
+    next_stamp();
+    PILOT_SEEN[start] = PILOT_STAMP;
+    for (int d = 0; d < DIRECTIONS; d++)
+    {
+        int n = start + PILOT_STEP[d];
+        if (ARROWS[d] == inertia || PILOT_WALL[n] || PILOT_SEEN[n] == PILOT_STAMP)
+        {
+            continue;
+        }
+        int r = flood(n, PILOT_CELLS);
+        if (r > room)
+        {
+            room = r;
+            best = d;
+        }
+    }
+    if (best >= 0)
+    {
+        return ARROWS[best];
+    }
+    // Boxed in, keep the current heading
+    return 0;
+}
+
+// Planner
+
+// Next move of the last plan while it holds: the snake is where the plan put it, the goal,
+// the goal count and the portal are as planned and the next cell is free, -1 to plan afresh
+int path_step(int start)
+{
+    if (PATH_NEXT >= PATH_LENGTH || PATH_GOALS != PLAN_GOAL_COUNT || PATH_PORTAL != PLAN_PORTAL
+        || !PILOT_GOAL[PATH_CELL[PATH_LENGTH - 1]] || PILOT_WALL[PATH_CELL[PATH_NEXT]])
+    {
+        return -1;
+    }
+    if ((PATH_NEXT == 0 ? PATH_START : PATH_CELL[PATH_NEXT - 1]) != start)
+    {
+        return -1;
+    }
+    return PATH_MOVE[PATH_NEXT];
+}
+
+// First move of the cheapest path from start into the goal sink, -1 when no goal is in
+// reach, the whole path is kept for path_step. Eating a goal costs MOVE_COST for each point
+// of value it falls short of the best goal, so the path cost weighs moves spent against what
+// the goal gives back. While the portal is open every cell reached before it closes has an
+// edge to it, a jump costs a straight step, or a diagonal one when the head points diagonally
+int plan(int start, char inertia)
+{
+    next_stamp();
+    PLAN_OPEN = 0;
+    PATH_LENGTH = 0;
+    PILOT_SEEN[start] = PILOT_STAMP;
+    PLAN_G[start] = 0;
+    PLAN_F[start] = estimate(start);
+    PLAN_TICKS[start] = 0;
+    const char *heading = strchr(ARROWS, backwards(inertia));
+    PLAN_MOVE[start] = (heading != NULL) ? heading - ARROWS : 0;
+    PLAN_HEAP[PLAN_OPEN] = start;
+    PLAN_SLOT[start] = PLAN_OPEN++;
+    while (PLAN_OPEN > 0)
+    {
+        int c = PLAN_HEAP[0];
+        PLAN_HEAP[0] = PLAN_HEAP[--PLAN_OPEN];
+        PLAN_SLOT[PLAN_HEAP[0]] = 0;
+        heap_down(0);
+        if (c == PLAN_SINK)
+        {
+            // Walk the path back from its goal
+            for (int n = PLAN_FROM[PLAN_SINK]; n != start; n = PLAN_FROM[n])
+            {
+                PATH_LENGTH++;
+            }
+            int i = PATH_LENGTH;
+            for (int n = PLAN_FROM[PLAN_SINK]; n != start; n = PLAN_FROM[n])
+            {
+                i--;
+                PATH_CELL[i] = n;
+                PATH_MOVE[i] = PLAN_MOVE[n];
+            }
+            PATH_START = start;
+            PATH_NEXT = 0;
+            PATH_GOALS = PLAN_GOAL_COUNT;
+            PATH_PORTAL = PLAN_PORTAL;
+            return (PATH_LENGTH > 0) ? PATH_MOVE[0] : -1;
+        }
+        PLAN_CLOSED[c] = PILOT_STAMP;
+        if (PILOT_GOAL[c])
+        {
+            relax(PLAN_SINK, PLAN_G[c] + MOVE_COST * (PLAN_BEST - PLAN_VALUE[c]), c, -1);
+        }
+        for (int d = 0; d < DIRECTIONS; d++)
+        {
+            int n = c + PILOT_STEP[d];
+            if (PILOT_WALL[n] || PLAN_CLOSED[n] == PILOT_STAMP || (c == start && ARROWS[d] == inertia))
+            {
+                continue;
+            }
+            relax(n, PLAN_G[c] + PLAN_COST[d], c, d);
+        }
+        if (PLAN_PORTAL >= 0 && PLAN_TICKS[c] < PLAN_WINDOW && !PILOT_WALL[PLAN_PORTAL]
+            && PLAN_CLOSED[PLAN_PORTAL] != PILOT_STAMP)
+        {
+            relax(PLAN_PORTAL, PLAN_G[c] + PLAN_COST[PLAN_MOVE[c]], c, PLAN_TELEPORT);
+        }
+    }
+    return -1;
+}
+
+// Admissible estimate from c into the sink: the cheapest free grid path to a goal plus its
+// penalty, or a straight step to the open portal and on from there when that is cheaper
+int estimate(int c)
+{
+    if (c == PLAN_SINK)
+    {
+        return 0;
+    }
+    int best = INT_MAX;
+    for (int i = 0; i < PLAN_GOAL_COUNT; i++)
+    {
+        int g = PLAN_GOALS[i];
+        int h = distance_cost(c, g) + MOVE_COST * (PLAN_BEST - PLAN_VALUE[g]);
+        if (PLAN_PORTAL >= 0)
+        {
+            h = min(h, STRAIGHT_COST + distance_cost(PLAN_PORTAL, g) + MOVE_COST * (PLAN_BEST - PLAN_VALUE[g]));
+        }
+        best = min(best, h);
+    }
+    return best;
+}
+
+// Cheapest free grid path from c to g, a diagonal step is cheaper than two straight ones
+// so it takes min(dx, dy) of them
+int distance_cost(int c, int g)
+{
+    int dx = abs(c % PILOT_WIDTH - g % PILOT_WIDTH);
+    int dy = abs(c / PILOT_WIDTH - g / PILOT_WIDTH);
+    return DIAGONAL_COST * min(dx, dy) + STRAIGHT_COST * (max(dx, dy) - min(dx, dy));
+}
+
+// Reach node n at cost g from node from by move, open it or lower its cost
+void relax(int n, int g, int from, int move)
+{
+    if (PILOT_SEEN[n] != PILOT_STAMP)
+    {
+        PILOT_SEEN[n] = PILOT_STAMP;
+        PLAN_G[n] = g;
+        PLAN_F[n] = g + estimate(n);
+        PLAN_FROM[n] = from;
+        PLAN_MOVE[n] = move;
+        PLAN_TICKS[n] = PLAN_TICKS[from] + 1;
+        PLAN_HEAP[PLAN_OPEN] = n;
+        PLAN_SLOT[n] = PLAN_OPEN++;
+        heap_up(PLAN_SLOT[n]);
+    }
+    else if (g < PLAN_G[n])
+    {
+        PLAN_F[n] -= PLAN_G[n] - g;
+        PLAN_G[n] = g;
+        PLAN_FROM[n] = from;
+        PLAN_MOVE[n] = move;
+        PLAN_TICKS[n] = PLAN_TICKS[from] + 1;
+        heap_up(PLAN_SLOT[n]);
+    }
+    return;
+}
+
+// Move heap entry i up while it estimates less than its parent
+void heap_up(int i)
+{
+    int n = PLAN_HEAP[i];
+    while (i > 0 && PLAN_F[PLAN_HEAP[(i - 1) / 2]] > PLAN_F[n])
+    {
+        PLAN_HEAP[i] = PLAN_HEAP[(i - 1) / 2];
+        PLAN_SLOT[PLAN_HEAP[i]] = i;
+        i = (i - 1) / 2;
+    }
+    PLAN_HEAP[i] = n;
+    PLAN_SLOT[n] = i;
+    return;
+}
+
+// Move heap entry i down while a child estimates less
+void heap_down(int i)
+{
+    if (PLAN_OPEN == 0)
+    {
+        return;
+    }
+    int n = PLAN_HEAP[i];
+    while (2 * i + 1 < PLAN_OPEN)
+    {
+        int child = 2 * i + 1;
+        if (child + 1 < PLAN_OPEN && PLAN_F[PLAN_HEAP[child + 1]] < PLAN_F[PLAN_HEAP[child]])
+        {
+            child++;
+        }
+        if (PLAN_F[PLAN_HEAP[child]] >= PLAN_F[n])
+        {
+            break;
+        }
+        PLAN_HEAP[i] = PLAN_HEAP[child];
+        PLAN_SLOT[PLAN_HEAP[i]] = i;
+        i = child;
+    }
+    PLAN_HEAP[i] = n;
+    PLAN_SLOT[n] = i;
+    return;
+}
+
+// Replays
+
+// Next number of the spawn random stream, the generator of the C standard kept in RANDOM so
+// that a keyframe restores it
+int next_random(void)
+{
+    RANDOM = RANDOM * 1103515245u + 12345u;
+    return (RANDOM >> 16) & 0x7FFF;
+}
+
+// Write a 32-bit value low byte first
+void put32(ostream &out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        out.put((char) (value >> (8 * i)));
+    }
+    return;
+}
+
+// Read a 32-bit value low byte first
+uint32_t get32(const string &in, size_t at)
+{
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--)
+    {
+        value = (value << 8) | (uint8_t) in[at + i];
+    }
+    return value;
+}
+
+// Append a number in 7-bit groups, low group first, its sign in the lowest bit
+void put_number(string *out, long value)
+{
+    unsigned long bits = (value < 0) ? ((unsigned long) ~value << 1) | 1 : (unsigned long) value << 1;
+    while (bits >= 0x80)
+    {
+        out->push_back((char) (bits | 0x80));
+        bits >>= 7;
+    }
+    out->push_back((char) bits);
+    return;
+}
+
+// Read a number written by put_number, false if it runs past the end
+bool get_number(const string &in, size_t *at, long *value)
+{
+    unsigned long bits = 0;
+    for (int shift = 0; *at < in.size() && shift < 64; shift += 7)
+    {
+        uint8_t group = in[(*at)++];
+        bits |= (unsigned long) (group & 0x7F) << shift;
+        if (!(group & 0x80))
+        {
+            *value = (bits & 1) ? ~(long) (bits >> 1) : (long) (bits >> 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// FNV-1a hash of the snake cells from the tail and of the apple and trap cells
+uint32_t digest(node *tail)
+{
+    uint32_t hash = 2166136261u;
+    for (node *ptr = tail; ptr != NULL; ptr = ptr->prev)
+    {
+        hash = (hash ^ (uint32_t) (ptr->y * COLUMNS + ptr->x)) * 16777619u;
+    }
+    for (int i = 0; i < ROWS; i++)
+    {
+        for (int j = 0; j < COLUMNS; j++)
+        {
+            hash = (hash ^ (uint32_t) (GRID[i][j].apple + 2 * GRID[i][j].trap)) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+// Direction bits of a node as a keyframe holds them
+int heading(node *n)
+{
+    return (n->diagonal << 2) | (n->axis << 1) | n->direction;
+}
+
+// Point a node by direction bits from a keyframe
+void set_heading(node *n, int code)
+{
+    n->diagonal = code & 4;
+    n->axis = code & 2;
+    n->direction = code & 1;
+    return;
+}
+
+// Cell a node takes when it trails the node ahead of it, the cell that node came from: a
+// step of its direction back
+void trail(node *lead, int *x, int *y)
+{
+    node step = *lead;
+    step.x = 0;
+    step.y = 0;
+    move_node(&step);
+    *x = lead->x - step.x;
+    *y = lead->y - step.y;
+    return;
+}
+
+// Keyframe of the state before a tick: the tick, the random stream, the counters, the snake
+// from the head, then the apples with their ages, traps with their ages and portals
+string encode_keyframe(node *head, node *tail, const counters &c)
+{
+    string out;
+    put_number(&out, REPLAY_TICKS);
+    put_number(&out, RANDOM);
+    long values[KEYFRAME_COUNTERS] = {c.inertia, c.cursor, c.speed, c.sped_up, c.ate, c.size, c.score, c.moves, c.run, c.teleport_time, c.portal_x, c.portal_y};
+    for (int i = 0; i < KEYFRAME_COUNTERS; i++)
+    {
+        put_number(&out, values[i]);
+    }
+
+    vector<node *> nodes;
+    for (node *ptr = tail; ptr != NULL; ptr = ptr->prev)
+    {
+        nodes.push_back(ptr);
+    }
+    put_number(&out, nodes.size());
+    put_number(&out, head->x);
+    put_number(&out, head->y);
+    string cells;
+    int byte = 0;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        node *n = nodes[nodes.size() - 1 - i];
+        int code = heading(n);
+        int x = n->x;
+        int y = n->y;
+        if (i > 0)
+        {
+            trail(nodes[nodes.size() - i], &x, &y);
+        }
+        if (x != n->x || y != n->y)
+        {
+            code |= KEYFRAME_OFF;
+            put_number(&cells, n->x);
+            put_number(&cells, n->y);
+        }
+        byte |= code << (4 * (i % 2));
+        if (i % 2 == 1 || i == nodes.size() - 1)
+        {
+            out.push_back((char) byte);
+            byte = 0;
+        }
+    }
+    out += cells;
+
+    string items;
+    long count;
+    items.clear();
+    count = 0;
+    for (int i = 0; i < ROWS; i++)
+    {
+        for (int j = 0; j < COLUMNS; j++)
+        {
+            if (GRID[i][j].apple)
+            {
+                put_number(&items, i * COLUMNS + j);
+                put_number(&items, GRID[i][j].apple_age);
+                count++;
+            }
+        }
+    }
+    put_number(&out, count);
+    out += items;
+    items.clear();
+    count = 0;
+    for (int i = 0; i < ROWS; i++)
+    {
+        for (int j = 0; j < COLUMNS; j++)
+        {
+            if (GRID[i][j].trap)
+            {
+                put_number(&items, i * COLUMNS + j);
+                put_number(&items, GRID[i][j].trap_age);
+                count++;
+            }
+        }
+    }
+    put_number(&out, count);
+    out += items;
+    items.clear();
+    count = 0;
+    for (int i = 0; i < ROWS; i++)
+    {
+        for (int j = 0; j < COLUMNS; j++)
+        {
+            if (GRID[i][j].portal)
+            {
+                put_number(&items, i * COLUMNS + j);
+                count++;
+            }
+        }
+    }
+    put_number(&out, count);
+    out += items;
+    return out;
+}
+
+// Item list of a keyframe: its count, then each cell with its age when the items age, as cell
+// and age pairs in items, false unless every cell is on the grid
+bool get_items(size_t *at, bool aged, vector<long> *items)
+{
+    long count;
+    if (!get_number(REPLAY_IN, at, &count) || count < 0 || count > ROWS * COLUMNS)
+    {
+        return false;
+    }
+    for (long i = 0; i < count; i++)
+    {
+        long cell;
+        long age = 0;
+        if (!get_number(REPLAY_IN, at, &cell) || cell < 0 || cell >= ROWS * COLUMNS || (aged && !get_number(REPLAY_IN, at, &age)))
+        {
+            return false;
+        }
+        items->push_back(cell);
+        items->push_back(age);
+    }
+    return true;
+}
+
+// Restore the state a keyframe between at and end holds, false unless it is the keyframe of
+// tick expect and decodes whole onto the grid, in which case nothing changes
+bool decode_keyframe(size_t at, size_t end, long expect, node **head, node **tail, counters *c)
+{
+    long tick;
+    long random;
+    long values[KEYFRAME_COUNTERS];
+    if (!get_number(REPLAY_IN, &at, &tick) || tick != expect || !get_number(REPLAY_IN, &at, &random))
+    {
+        return false;
+    }
+    for (int i = 0; i < KEYFRAME_COUNTERS; i++)
+    {
+        if (!get_number(REPLAY_IN, &at, &values[i]))
+        {
+            return false;
+        }
+    }
+    long count;
+    long x;
+    long y;
+    if (!get_number(REPLAY_IN, &at, &count) || !get_number(REPLAY_IN, &at, &x) || !get_number(REPLAY_IN, &at, &y)
+        || count < 1 || count > ROWS * COLUMNS || at + (count + 1) / 2 > end)
+    {
+        return false;
+    }
+    size_t codes = at;
+    at += (count + 1) / 2;
+    node *first = NULL;
+    node *last = NULL;
+    bool fits = true;
+    for (long i = 0; i < count && fits; i++)
+    {
+        node *n = new node;
+        int code = ((uint8_t) REPLAY_IN[codes + i / 2] >> (4 * (i % 2))) & 0xF;
+        set_heading(n, code & ~KEYFRAME_OFF);
+        n->prev = last;
+        if (last == NULL)
+        {
+            first = n;
+            n->x = x;
+            n->y = y;
+        }
+        else if (code & KEYFRAME_OFF)
+        {
+            fits = get_number(REPLAY_IN, &at, &x) && get_number(REPLAY_IN, &at, &y);
+            n->x = x;
+            n->y = y;
+        }
+        else
+        {
+            trail(last, &n->x, &n->y);
+        }
+        fits = fits && n->x >= 0 && n->x < COLUMNS && n->y >= 0 && n->y < ROWS;
+        last = n;
+    }
+    // Every item list is read and checked before anything changes, a keyframe that fails
+    // leaves the board and the snake it was sought from as they were
+    vector<long> apples;
+    vector<long> traps;
+    vector<long> portals;
+    if (!fits || !get_items(&at, true, &apples) || !get_items(&at, true, &traps) || !get_items(&at, false, &portals) || at != end)
+    {
+        lfree(last);
+        return false;
+    }
+
+    for (int i = 0; i < ROWS; i++)
+    {
+        for (int j = 0; j < COLUMNS; j++)
+        {
+            GRID[i][j].apple = false;
+            GRID[i][j].apple_age = 0;
+            GRID[i][j].trap = false;
+            GRID[i][j].trap_age = 0;
+            GRID[i][j].portal = false;
+        }
+    }
+    for (size_t i = 0; i < apples.size(); i += 2)
+    {
+        GRID[apples[i] / COLUMNS][apples[i] % COLUMNS].apple = true;
+        GRID[apples[i] / COLUMNS][apples[i] % COLUMNS].apple_age = apples[i + 1];
+    }
+    for (size_t i = 0; i < traps.size(); i += 2)
+    {
+        GRID[traps[i] / COLUMNS][traps[i] % COLUMNS].trap = true;
+        GRID[traps[i] / COLUMNS][traps[i] % COLUMNS].trap_age = traps[i + 1];
+    }
+    for (size_t i = 0; i < portals.size(); i += 2)
+    {
+        GRID[portals[i] / COLUMNS][portals[i] % COLUMNS].portal = true;
+    }
+    *head = first;
+    *tail = last;
+
+    RANDOM = random;
+    REPLAY_TICKS = tick;
+    c->inertia = values[0];
+    c->cursor = values[1];
+    c->speed = values[2];
+    c->sped_up = values[3];
+    c->ate = values[4];
+    c->size = values[5];
+    c->score = values[6];
+    c->moves = values[7];
+    c->run = values[8];
+    c->teleport_time = values[9];
+    c->portal_x = values[10];
+    c->portal_y = values[11];
+    return true;
+}
+
+// Start the replay of a session: the variant, its rule constants and the seed
+bool start_replay(const char *path, unsigned seed)
+{
+    REPLAY_OUT.open(path, ios::binary | ios::trunc);
+    if (!REPLAY_OUT)
+    {
+        return false;
+    }
+    REPLAY_OUT.write(REPLAY_MAGIC, 4);
+    REPLAY_OUT.put((char) REPLAY_VERSION);
+    REPLAY_OUT.put((char) REPLAY_VARIANT);
+    REPLAY_OUT.put((char) REPLAY_BITS);
+    REPLAY_OUT.put((char) REPLAY_RULE_COUNT);
+    for (int i = 0; i < REPLAY_RULE_COUNT; i++)
+    {
+        put32(REPLAY_OUT, REPLAY_RULES[i]);
+    }
+    put32(REPLAY_OUT, seed);
+    put32(REPLAY_OUT, REPLAY_KEYFRAME);
+    return true;
+}
+
+// Keyframe before the ticks that follow: a session writes it ahead of their records, its
+// length first, a playback checks it against the state it played up to and reads on past it
+void keep_keyframe(node *head, node *tail, const counters &c)
+{
+    if (PLAYBACK)
+    {
+        size_t k = REPLAY_TICKS / REPLAY_KEYFRAME;
+        size_t at = (REPLAY_AT + 7) / 8;
+        long length;
+        if (k >= REPLAY_INDEX.size() || REPLAY_INDEX[k] != at || !get_number(REPLAY_IN, &at, &length)
+            || REPLAY_IN.compare(at, length, encode_keyframe(head, tail, c)) != 0)
+        {
+            REPLAY_MATCH = false;
+            return;
+        }
+        REPLAY_AT = (at + length) * 8;
+        return;
+    }
+    if (!REPLAY_OUT.is_open())
+    {
+        return;
+    }
+    if (REPLAY_FILL > 0)
+    {
+        REPLAY_OUT.put((char) REPLAY_BYTE);
+        REPLAY_BYTE = 0;
+        REPLAY_FILL = 0;
+    }
+    REPLAY_INDEX.push_back(REPLAY_OUT.tellp());
+    string frame = encode_keyframe(head, tail, c);
+    string length;
+    put_number(&length, frame.size());
+    REPLAY_OUT << length << frame;
+    return;
+}
+
+// Append a record of REPLAY_BITS bits, low bits first, a byte goes out once it is full
+void put_record(int record)
+{
+    REPLAY_BYTE |= record << REPLAY_FILL;
+    REPLAY_FILL += REPLAY_BITS;
+    if (REPLAY_FILL == 8)
+    {
+        REPLAY_OUT.put((char) REPLAY_BYTE);
+        REPLAY_BYTE = 0;
+        REPLAY_FILL = 0;
+    }
+    return;
+}
+
+// Record the input of a tick: the event its key caused, then the cursor it moves by
+void record_tick(char cursor, char key)
+{
+    if (!REPLAY_OUT.is_open())
+    {
+        return;
+    }
+    if (key == 'F')
+    {
+        put_record(REPLAY_FLAG | REPLAY_SPEED);
+    }
+    else if (key == 'T')
+    {
+        put_record(REPLAY_FLAG | REPLAY_JUMP);
+    }
+    const char *arrow = strchr(ARROWS, cursor);
+    put_record((cursor != 0 && arrow != NULL) ? arrow - ARROWS : REPLAY_FLAG | REPLAY_KEEP);
+    REPLAY_TICKS++;
+    return;
+}
+
+// Finish the replay of a session: the last partial byte, the keyframe index, then the end
+// marker and the final state a playback is checked against
+void finish_replay(int score, int size, int moves, node *tail)
+{
+    if (!REPLAY_OUT.is_open())
+    {
+        return;
+    }
+    if (REPLAY_FILL > 0)
+    {
+        REPLAY_OUT.put((char) REPLAY_BYTE);
+    }
+    uint32_t index = REPLAY_OUT.tellp();
+    for (uint32_t offset : REPLAY_INDEX)
+    {
+        put32(REPLAY_OUT, offset);
+    }
+    REPLAY_OUT.write(REPLAY_END, 4);
+    put32(REPLAY_OUT, REPLAY_INDEX.size());
+    put32(REPLAY_OUT, index);
+    put32(REPLAY_OUT, REPLAY_TICKS);
+    put32(REPLAY_OUT, score);
+    put32(REPLAY_OUT, size);
+    put32(REPLAY_OUT, moves);
+    put32(REPLAY_OUT, digest(tail));
+    REPLAY_OUT.close();
+    return;
+}
+
+// Read a replay for playback, false unless this variant wrote it under the same rules and
+// it ends with its keyframe index and final state
+bool load_replay(const char *path, unsigned *seed)
+{
+    ifstream in(path, ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+    REPLAY_IN.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    size_t size = REPLAY_IN.size();
+    if (size < (size_t) (REPLAY_HEADER + REPLAY_FOOTER) || REPLAY_IN.compare(0, 4, REPLAY_MAGIC) != 0
+        || REPLAY_IN[4] != REPLAY_VERSION || REPLAY_IN[5] != REPLAY_VARIANT || REPLAY_IN[6] != REPLAY_BITS
+        || REPLAY_IN[7] != REPLAY_RULE_COUNT || REPLAY_IN.compare(size - REPLAY_FOOTER, 4, REPLAY_END) != 0
+        || get32(REPLAY_IN, REPLAY_HEADER - 4) != (uint32_t) REPLAY_KEYFRAME)
+    {
+        return false;
+    }
+    for (int i = 0; i < REPLAY_RULE_COUNT; i++)
+    {
+        if (get32(REPLAY_IN, 8 + 4 * i) != (uint32_t) REPLAY_RULES[i])
+        {
+            return false;
+        }
+    }
+    size_t end = size - REPLAY_FOOTER;
+    size_t count = get32(REPLAY_IN, end + 4);
+    REPLAY_STOP = get32(REPLAY_IN, end + 8);
+    if (count == 0 || REPLAY_STOP < (size_t) REPLAY_HEADER || REPLAY_STOP + 4 * count != end)
+    {
+        return false;
+    }
+    for (size_t k = 0; k < count; k++)
+    {
+        uint32_t offset = get32(REPLAY_IN, REPLAY_STOP + 4 * k);
+        if (offset >= REPLAY_STOP || (k == 0 ? offset != (uint32_t) REPLAY_HEADER : offset <= REPLAY_INDEX.back()))
+        {
+            return false;
+        }
+        REPLAY_INDEX.push_back(offset);
+    }
+    *seed = get32(REPLAY_IN, REPLAY_HEADER - 8);
+    REPLAY_AT = REPLAY_HEADER * 8;
+    PLAYBACK = true;
+    REPLAY_CLOCK = now_us();
+    return true;
+}
+
+// Start a playback at the keyframe before a tick instead of the first tick, the game loop
+// checks that keyframe again and plays on up to the tick
+bool seek_replay(long tick, node **head, node **tail, counters *c)
+{
+    REPLAY_CLOCK = now_us();
+    long ticks = get32(REPLAY_IN, REPLAY_IN.size() - REPLAY_FOOTER + 12);
+    if (tick < 0 || tick >= ticks)
+    {
+        return false;
+    }
+    size_t k = min((size_t) tick / REPLAY_KEYFRAME, REPLAY_INDEX.size() - 1);
+    size_t at = REPLAY_INDEX[k];
+    long length;
+    node *first;
+    node *last;
+    if (!get_number(REPLAY_IN, &at, &length) || length < 0 || at + length > REPLAY_STOP
+        || !decode_keyframe(at, at + length, (long) k * REPLAY_KEYFRAME, &first, &last, c))
+    {
+        return false;
+    }
+    lfree(*tail);
+    *head = first;
+    *tail = last;
+    REPLAY_AT = REPLAY_INDEX[k] * 8;
+    REPLAY_SEEK = tick;
+    return true;
+}
+
+// Tick a playback sought and the time it took from the keyframe before it
+void print_seek(void)
+{
+    cout << "\nSEEK tick " << REPLAY_SEEK << " from keyframe " << REPLAY_SEEK / REPLAY_KEYFRAME * REPLAY_KEYFRAME
+         << " in " << now_us() - REPLAY_CLOCK << " us\n";
+    return;
+}
+
+// Next record of the replay, -1 past the last one
+int get_record(void)
+{
+    if (REPLAY_AT + REPLAY_BITS > REPLAY_STOP * 8)
+    {
+        return -1;
+    }
+    int record = ((uint8_t) REPLAY_IN[REPLAY_AT / 8] >> (REPLAY_AT % 8)) & ((1 << REPLAY_BITS) - 1);
+    REPLAY_AT += REPLAY_BITS;
+    return record;
+}
+
+// Input of the next tick of a replay: an event comes back as the key that caused it and the
+// cursor as an autopilot move, a kept cursor as no move
+void replay_tick(char *pilot, char *key)
+{
+    *pilot = 0;
+    *key = 0;
+    int record = get_record();
+    while (record >= 0 && record != (REPLAY_FLAG | REPLAY_KEEP) && (record & REPLAY_FLAG))
+    {
+        *key = (record == (REPLAY_FLAG | REPLAY_SPEED)) ? 'F' : 'T';
+        record = get_record();
+    }
+    if (record >= 0)
+    {
+        if (!(record & REPLAY_FLAG))
+        {
+            *pilot = ARROWS[record];
+        }
+        REPLAY_TICKS++;
+    }
+    return;
+}
+
+// Compare the end of a playback with the end its replay recorded
+bool check_replay(int score, int size, int moves, node *tail)
+{
+    size_t end = REPLAY_IN.size() - REPLAY_FOOTER;
+    long ticks = get32(REPLAY_IN, end + 12);
+    int recorded[] = {(int) get32(REPLAY_IN, end + 16), (int) get32(REPLAY_IN, end + 20), (int) get32(REPLAY_IN, end + 24)};
+    bool same = REPLAY_MATCH && (REPLAY_AT + 7) / 8 == REPLAY_STOP && REPLAY_TICKS == ticks && score == recorded[0]
+             && size == recorded[1] && moves == recorded[2] && digest(tail) == get32(REPLAY_IN, end + 28);
+    cout << "\nREPLAY ticks " << REPLAY_TICKS << " keyframes " << REPLAY_INDEX.size() << " score " << score
+         << " size " << size << " moves " << moves << " in " << now_us() - REPLAY_CLOCK << " us: "
+         << (same ? "verified" : "MISMATCH") << "\n";
+    if (!same)
+    {
+        cout << "RECORDED ticks " << ticks << " score " << recorded[0] << " size " << recorded[1]
+             << " moves " << recorded[2] << (REPLAY_MATCH ? "" : ", a keyframe differs") << "\n";
+    }
+    return same;
+}
@@ -0,0 +1,464 @@
+// TOURNAMENT: plays every registered agent on every variant over a fixed seed set on every core,
+// reports score and survival with confidence intervals and checks them against a baseline
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+#include "agents.h"
+
+using namespace std;
+
+// Constant: Ticks after which a tournament game is called off
+const long MATCH_TICK_LIMIT = 5000;
+
+// Constant: Rollouts the search agent plays per move by default, about 2 ms of search but
+// the same on every machine and run
+const long MATCH_ROLLOUTS = 500;
+
+// Constant: Normal quantile of the 95% confidence intervals
+const double Z95 = 1.96;
+
+// Data type: One game of an agent on a variant and how it went
+struct match
+{
+    int agent;
+    int variant;
+    uint64_t seed;
+    int score;
+    int ticks;
+    int death;
+};
+
+// Data type: Results of one agent on one variant
+struct standing
+{
+    string agent;
+    string variant;
+    long games;
+    double score;
+    double score_ci;
+    double ticks;
+    double ticks_ci;
+    long deaths[DEATHS];
+};
+
+// Prototypes
+bool parse_list(const char *list, bool agents, vector<int> *picked);
+void play_matches(vector<match> *matches, atomic<long> *next, const vector<budget_table> *plans, const agent_state *setup,
+                  long limit);
+void play_match(match *m, const budget_table &plan, const agent_state &setup, long limit);
+standing tally(const vector<match> &matches, int agent, int variant);
+void mean_ci(const vector<double> &values, double *mean, double *ci);
+void print_table(const char *title, const vector<standing> &standings, const vector<int> &agents,
+                 const vector<int> &variants, bool score);
+void write_results(ostream &out, const vector<standing> &standings);
+bool read_results(const char *path, vector<standing> *standings);
+int regressions(const vector<standing> &now, const vector<standing> &base);
+
+int main(int argc, char *argv[])
+{
+    // Options: -a AGENTS and -v VARIANTS pick comma separated names (all by default, the variants
+    // that fit the bitboard engine), -n SEEDS games each from -s SEED, -t THREADS to use,
+    // -r ROLLOUTS searched per move, or -m MS with -r 0, -x KEYS the scripted agent plays over
+    // and over, -k TICKS calls a game off, -o FILE writes the results as CSV, -c FILE
+    // compares with earlier results and exits 2 when an agent scores worse
+    vector<int> agents;
+    vector<int> variants;
+    long seeds = 10;
+    uint64_t seed = 1;
+    int threads = thread::hardware_concurrency();
+    double ms = 2;
+    long iterations = MATCH_ROLLOUTS;
+    const char *script = SCRIPT;
+    long limit = MATCH_TICK_LIMIT;
+    const char *path = NULL;
+    const char *baseline = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "a:v:n:s:t:m:r:x:k:o:c:")) != -1)
+    {
+        if (opt == 'a' || opt == 'v')
+        {
+            if (!parse_list(optarg, opt == 'a', opt == 'a' ? &agents : &variants))
+            {
+                return 1;
+            }
+        }
+        else if (opt == 'n')
+        {
+            seeds = atol(optarg);
+        }
+        else if (opt == 's')
+        {
+            seed = strtoull(optarg, NULL, 10);
+        }
+        else if (opt == 't')
+        {
+            threads = atoi(optarg);
+        }
+        else if (opt == 'm')
+        {
+            ms = atof(optarg);
+        }
+        else if (opt == 'r')
+        {
+            iterations = atol(optarg);
+        }
+        else if (opt == 'x')
+        {
+            script = optarg;
+        }
+        else if (opt == 'k')
+        {
+            limit = atol(optarg);
+        }
+        else if (opt == 'o')
+        {
+            path = optarg;
+        }
+        else if (opt == 'c')
+        {
+            baseline = optarg;
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-a AGENTS] [-v VARIANTS] [-n SEEDS] [-s SEED] [-t THREADS] [-r ROLLOUTS] [-m MS] [-x KEYS] [-k TICKS] [-o FILE] [-c FILE]\n";
+            return 1;
+        }
+    }
+    threads = max(threads, 1);
+    if (script[0] == '\0' || strspn(script, KEYS) != strlen(script))
+    {
+        cerr << "Bad script " << script << ", expected keys of " << KEYS << "\n";
+        return 1;
+    }
+    if (agents.empty())
+    {
+        for (int a = 0; a < AGENT_COUNT; a++)
+        {
+            agents.push_back(a);
+        }
+    }
+    if (variants.empty())
+    {
+        for (int v = 0; v < VARIANTS; v++)
+        {
+            if (board_fits(RULES[v]))
+            {
+                variants.push_back(v);
+            }
+        }
+    }
+    for (int v : variants)
+    {
+        if (!board_fits(RULES[v]))
+        {
+            cerr << "Variant " << RULES[v].name << " does not fit the bitboard engine\n";
+            return 1;
+        }
+    }
+
+    // The budget prices are worked out once and shared, every agent plays the same seeds
+    vector<budget_table> plans(VARIANTS);
+    for (int v : variants)
+    {
+        plans[v] = make_budget(RULES[v]);
+    }
+    vector<match> matches;
+    for (int a : agents)
+    {
+        for (int v : variants)
+        {
+            for (long i = 0; i < seeds; i++)
+            {
+                matches.push_back({a, v, seed + i, 0, 0, NONE});
+            }
+        }
+    }
+    agent_state setup = {NULL, NULL, 0, ms, iterations, script, {}, {}};
+    atomic<long> next(0);
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++)
+    {
+        pool.emplace_back(play_matches, &matches, &next, &plans, &setup, limit);
+    }
+    for (thread &t : pool)
+    {
+        t.join();
+    }
+
+    vector<standing> standings;
+    for (int a : agents)
+    {
+        for (int v : variants)
+        {
+            standings.push_back(tally(matches, a, v));
+        }
+    }
+    cout << "TOURNAMENT agents " << agents.size() << " variants " << variants.size() << " seeds " << seeds
+         << " from " << seed << " threads " << threads;
+    if (iterations > 0)
+    {
+        cout << " rollouts/move " << iterations;
+    }
+    else
+    {
+        cout << " ms/move " << ms;
+    }
+    cout << " tick limit " << limit << "\n";
+    print_table("SCORE", standings, agents, variants, true);
+    print_table("SURVIVAL", standings, agents, variants, false);
+
+    if (path != NULL)
+    {
+        ofstream file(path);
+        if (!file)
+        {
+            cerr << "Cannot write " << path << "\n";
+            return 1;
+        }
+        write_results(file, standings);
+    }
+    if (baseline != NULL)
+    {
+        vector<standing> base;
+        if (!read_results(baseline, &base))
+        {
+            cerr << "Cannot read " << baseline << "\n";
+            return 1;
+        }
+        int worse = regressions(standings, base);
+        cout << "REGRESSIONS " << worse << "\n";
+        if (worse > 0)
+        {
+            return 2;
+        }
+    }
+    return 0;
+}
+
+// Read comma separated agent or variant names into their indices
+bool parse_list(const char *list, bool agents, vector<int> *picked)
+{
+    stringstream names(list);
+    string name;
+    while (getline(names, name, ','))
+    {
+        if (agents)
+        {
+            const agent *a = find_agent(name.c_str());
+            if (a == NULL)
+            {
+                cerr << "Unknown agent " << name << "\n";
+                return false;
+            }
+            picked->push_back(a - AGENTS);
+        }
+        else
+        {
+            const rules *r = find_rules(name.c_str());
+            if (r == NULL)
+            {
+                cerr << "Unknown variant " << name << "\n";
+                return false;
+            }
+            picked->push_back(r - RULES);
+        }
+    }
+    return true;
+}
+
+// Worker thread: play the next match until none are left
+void play_matches(vector<match> *matches, atomic<long> *next, const vector<budget_table> *plans, const agent_state *setup,
+                  long limit)
+{
+    long i;
+    while ((i = next->fetch_add(1)) < (long) matches->size())
+    {
+        match *m = &(*matches)[i];
+        play_match(m, (*plans)[m->variant], *setup, limit);
+    }
+    return;
+}
+
+// Play one match to its end or the tick limit, the agent set up as setup with the rules,
+// prices and random stream of the match
+void play_match(match *m, const budget_table &plan, const agent_state &setup, long limit)
+{
+    const rules &r = RULES[m->variant];
+    board b = {};
+    setup_board(&b, r, m->seed);
+    agent_state s = setup;
+    s.r = &r;
+    s.plan = &plan;
+    s.seed = m->seed ^ 0x5EA2C4ULL;
+    int death = NONE;
+    while (death == NONE && b.ticks < limit)
+    {
+        death = step_board(&b, r, AGENTS[m->agent].move(b, &s), NULL);
+    }
+    m->score = b.score;
+    m->ticks = b.ticks;
+    m->death = death;
+    return;
+}
+
+// Results of one agent on one variant
+standing tally(const vector<match> &matches, int agent, int variant)
+{
+    standing s = {};
+    s.agent = AGENTS[agent].name;
+    s.variant = RULES[variant].name;
+    vector<double> scores;
+    vector<double> ticks;
+    for (const match &m : matches)
+    {
+        if (m.agent == agent && m.variant == variant)
+        {
+            scores.push_back(m.score);
+            ticks.push_back(m.ticks);
+            s.deaths[m.death]++;
+        }
+    }
+    s.games = scores.size();
+    mean_ci(scores, &s.score, &s.score_ci);
+    mean_ci(ticks, &s.ticks, &s.ticks_ci);
+    return s;
+}
+
+// Mean and half width of its 95% confidence interval
+void mean_ci(const vector<double> &values, double *mean, double *ci)
+{
+    double n = values.size();
+    double sum = 0;
+    for (double v : values)
+    {
+        sum += v;
+    }
+    *mean = n > 0 ? sum / n : 0;
+    double squares = 0;
+    for (double v : values)
+    {
+        squares += (v - *mean) * (v - *mean);
+    }
+    *ci = n > 1 ? Z95 * sqrt(squares / (n - 1) / n) : 0;
+    return;
+}
+
+// Agents down, variants across, mean +- confidence of the score or of the ticks survived,
+// the survival table adds the games that reached the tick limit
+void print_table(const char *title, const vector<standing> &standings, const vector<int> &agents,
+                 const vector<int> &variants, bool score)
+{
+    cout << left << setw(10) << title << right;
+    for (int v : variants)
+    {
+        cout << setw(16) << RULES[v].name;
+    }
+    cout << "\n";
+    size_t i = 0;
+    for (int a : agents)
+    {
+        cout << left << setw(10) << AGENTS[a].name << right << fixed << setprecision(1);
+        for (size_t v = 0; v < variants.size(); v++, i++)
+        {
+            const standing &s = standings[i];
+            ostringstream cell;
+            cell << fixed << setprecision(score ? 1 : 0) << (score ? s.score : s.ticks) << " +-"
+                 << (score ? s.score_ci : s.ticks_ci);
+            if (!score)
+            {
+                cell << " " << s.deaths[NONE];
+            }
+            cout << setw(16) << cell.str();
+        }
+        cout << "\n";
+    }
+    return;
+}
+
+// CSV, one row per agent and variant
+void write_results(ostream &out, const vector<standing> &standings)
+{
+    out << "agent,variant,games,score_mean,score_ci,ticks_mean,ticks_ci";
+    for (int d = 0; d < DEATHS; d++)
+    {
+        out << "," << (d == NONE ? "tick_limit" : DEATH_NAMES[d]);
+    }
+    out << "\n";
+    for (const standing &s : standings)
+    {
+        out << s.agent << "," << s.variant << "," << s.games << fixed << setprecision(3)
+            << "," << s.score << "," << s.score_ci << "," << s.ticks << "," << s.ticks_ci;
+        for (int d = 0; d < DEATHS; d++)
+        {
+            out << "," << s.deaths[d];
+        }
+        out << "\n";
+    }
+    return;
+}
+
+// Read results written by write_results
+bool read_results(const char *path, vector<standing> *standings)
+{
+    ifstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+    string line;
+    getline(file, line);
+    while (getline(file, line))
+    {
+        stringstream fields(line);
+        standing s = {};
+        string value;
+        getline(fields, s.agent, ',');
+        getline(fields, s.variant, ',');
+        double *numbers[] = {&s.score, &s.score_ci, &s.ticks, &s.ticks_ci};
+        if (!getline(fields, value, ','))
+        {
+            continue;
+        }
+        s.games = atol(value.c_str());
+        for (double *n : numbers)
+        {
+            getline(fields, value, ',');
+            *n = atof(value.c_str());
+        }
+        for (int d = 0; d < DEATHS && getline(fields, value, ','); d++)
+        {
+            s.deaths[d] = atol(value.c_str());
+        }
+        standings->push_back(s);
+    }
+    return true;
+}
+
+// Print and count the agents whose score fell below their baseline, the confidence
+// intervals apart
+int regressions(const vector<standing> &now, const vector<standing> &base)
+{
+    int worse = 0;
+    for (const standing &s : now)
+    {
+        for (const standing &b : base)
+        {
+            if (s.agent == b.agent && s.variant == b.variant && s.score + s.score_ci < b.score - b.score_ci)
+            {
+                cout << "REGRESSION " << s.agent << " " << s.variant << fixed << setprecision(1)
+                     << " score " << s.score << " +-" << s.score_ci
+                     << " baseline " << b.score << " +-" << b.score_ci << "\n";
+                worse++;
+            }
+        }
+    }
+    return worse;
+}